@@ -3,28 +3,94 @@
 /******************************************************************************/
 /*                        Static function definitions                         */
 /******************************************************************************/
+static void pushEvent(buttonCtxt_t *me, buttonEvent_t ev)
+{
+    uint8_t head = me->evHead;
+
+    if ((uint8_t)(head - me->evTail) >= BUTTON_EVENT_QUEUE_SIZE) {
+        return; // Consumer is not keeping up, drop the newest
+    }
+
+    me->events[head & (BUTTON_EVENT_QUEUE_SIZE - 1)] = ev;
+    me->evHead = head + 1;
+}
 
 /******************************************************************************/
 /*                        Public function definitions                         */
 /******************************************************************************/
 void button_initHw(buttonCtxt_t *me)
 {
-    // Set button pin as input
-    *(me->ddr) &= ~(1 << me->bit);
-
-    if (me->pullUpEn) {
-        // Enable pull-up resistor
-        *(me->port) |= (1 << me->bit);
-    } else {
-        // Disable pull-up resistor
-        *(me->port) &= ~(1 << me->bit);
-    }
+    // Set button pin as input, pull-up as configured
+    me->pins->initHw();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 uint8_t button_isPressed(buttonCtxt_t *me)
 {
-    uint8_t pinState = (*(me->pin) & (1 << me->bit)) ? 1 : 0;
+    uint8_t pinState = me->pins->read();
     return (pinState == me->activeState) ? 1 : 0;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+
+void button_tick(buttonCtxt_t *me)
+{
+    if (button_isPressed(me)) {
+        if (me->integrator < BUTTON_INTEGRATOR_MAX) {
+            me->integrator++;
+        }
+    } else if (me->integrator) {
+        me->integrator--;
+    }
+
+    if (!me->pressed) {
+        if (me->integrator >= BUTTON_INTEGRATOR_MAX) {
+            me->pressed = 1;
+            me->holdTicks = 0;
+            pushEvent(me, button_event_press);
+        }
+        return;
+    }
+
+    if (me->integrator == 0) {
+        me->pressed = 0;
+        pushEvent(me, button_event_release);
+        return;
+    }
+
+    if (me->holdTicks < UINT16_MAX) {
+        me->holdTicks++;
+    }
+
+    if (me->holdTicks == BUTTON_LONG_PRESS_TICKS) {
+        pushEvent(me, button_event_longPress);
+    } else if (me->holdTicks > BUTTON_LONG_PRESS_TICKS &&
+               ((me->holdTicks - BUTTON_LONG_PRESS_TICKS) % BUTTON_REPEAT_TICKS) == 0) {
+        pushEvent(me, button_event_repeat);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+buttonEvent_t button_getEvent(buttonCtxt_t *me)
+{
+    uint8_t tail = me->evTail;
+    buttonEvent_t ev;
+
+    if (tail == me->evHead) {
+        return button_event_none;
+    }
+
+    ev = (buttonEvent_t)me->events[tail & (BUTTON_EVENT_QUEUE_SIZE - 1)];
+    me->evTail = tail + 1;
+
+    return ev;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint8_t button_isHeld(buttonCtxt_t *me)
+{
+    return me->pressed;
+}
@@ -4,29 +4,78 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <avr/io.h>
-#include <util/delay.h>
+#include "hal_lib.h"
+
+#include "gpio_lib.h"
+
+/* Debounce / event timing, in calls of button_tick() */
+#define BUTTON_TICK_MS              5
+#define BUTTON_INTEGRATOR_MAX       4       // 20 ms of stable level
+#define BUTTON_LONG_PRESS_TICKS     200     // 1 s
+#define BUTTON_REPEAT_TICKS         40      // 200 ms after a long press
+
+/* Pending events per button, must be a power of two */
+#define BUTTON_EVENT_QUEUE_SIZE     4
+
+typedef enum {
+    button_event_none = 0,
+    button_event_press,
+    button_event_release,
+    button_event_longPress,
+    button_event_repeat
+} buttonEvent_t;
+
+/* Pin access generated per context by BUTTON_DECLARE_CTXT */
+typedef struct {
+    void (*initHw)(void);
+    uint8_t (*read)(void);
+} buttonPins_t;
 
 typedef struct {
-    volatile uint8_t *ddr;
-    volatile uint8_t *port;
-    volatile uint8_t *pin;
-    uint8_t bit;
+    const buttonPins_t *pins;
 
     uint8_t activeState;
     uint8_t pullUpEn;
+
+    /* Integrator debounce: counts up while the pin reads active, down while
+    inactive; the debounced state only flips at 0 / BUTTON_INTEGRATOR_MAX */
+    uint8_t integrator;
+    uint8_t pressed;
+    uint16_t holdTicks;
+
+    uint8_t events[BUTTON_EVENT_QUEUE_SIZE];
+    uint8_t evHead;
+    uint8_t evTail;
 } buttonCtxt_t;
 
+#define BUTTON_DECLARE_PINS(name, buttPort, buttBit, isPullUp) \
+    GPIO_DECLARE_PIN(name##_pin, buttPort, buttBit) \
+    static void name##_initHw(void) \
+    { \
+        name##_pin_setInput(); \
+        /* Enable/disable pull-up resistor */ \
+        if (isPullUp) { name##_pin_setHigh(); } else { name##_pin_setLow(); } \
+    } \
+    static uint8_t name##_read(void) \
+    { \
+        return name##_pin_read(); \
+    } \
+    static const buttonPins_t name##_pins = { \
+        .initHw = name##_initHw, \
+        .read = name##_read \
+    };
+
 #define BUTTON_DECLARE_CTXT(name, buttPort, buttBit, actState, isPullUp) \
+    BUTTON_DECLARE_PINS(name, buttPort, buttBit, isPullUp) \
     buttonCtxt_t name = { \
-        /* DDR register is PORT - 1 */ \
-        /* PIN register is PORT - 2 */ \
-        .ddr = &(buttPort), \
-        .port = &(buttPort), \
-        .pin = &(buttPort) - 2, \
-        .bit = (buttBit), \
+        .pins = &name##_pins, \
         .activeState = (actState), \
         .pullUpEn = (isPullUp), \
+        .integrator = 0, \
+        .pressed = 0, \
+        .holdTicks = 0, \
+        .evHead = 0, \
+        .evTail = 0 \
     };
 
 #define TM16_DELAY_US(us) _delay_us(us) // Placeholder for delay function
@@ -46,5 +95,28 @@ void button_initHw(buttonCtxt_t *me);
  */
 uint8_t button_isPressed(buttonCtxt_t *me);
 
+/**
+ * @fn button_tick
+ * @param me - Pointer to the button context structure.
+ * @brief Sample the pin and run debouncing; call every BUTTON_TICK_MS.
+ *        Queues press/release, one longPress after BUTTON_LONG_PRESS_TICKS
+ *        and a repeat every BUTTON_REPEAT_TICKS while still held.
+ */
+void button_tick(buttonCtxt_t *me);
+
+/**
+ * @fn button_getEvent
+ * @param me - Pointer to the button context structure.
+ * @return Oldest queued event, button_event_none if there is none.
+ */
+buttonEvent_t button_getEvent(buttonCtxt_t *me);
+
+/**
+ * @fn button_isHeld
+ * @param me - Pointer to the button context structure.
+ * @return 1 while the debounced state is pressed, 0 otherwise.
+ */
+uint8_t button_isHeld(buttonCtxt_t *me);
+
 /* _BUTTON_LIB_H_ */
 #endif
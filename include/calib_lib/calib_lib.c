@@ -0,0 +1,118 @@
+#include "calib_lib.h"
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+
+/* (x * mul + 2^(shift-1)) >> shift. A shift of 32 or more lets the compiler
+take the upper word of the widening product instead of a 64-bit shift. */
+static inline int32_t mulShift(int32_t x, int32_t mul, uint8_t shift)
+{
+    int64_t prod = (int64_t)x * mul;
+
+    if (shift == 0) {
+        return (int32_t)prod;
+    }
+
+    prod += (int64_t)1 << (shift - 1);
+
+    if (shift >= 32) {
+        return (int32_t)(prod >> 32) >> (shift - 32);
+    }
+
+    return (int32_t)(prod >> shift);
+}
+
+static int32_t linearize(const calibCtxt_t *me, int32_t x)
+{
+    uint8_t seg = 0;
+
+    // Pick the segment, end segments extend beyond the table
+    while ((seg < me->points - 2) && (x >= me->pt[seg + 1].in)) {
+        seg++;
+    }
+
+    return me->pt[seg].out + mulShift(x - me->pt[seg].in, me->slope_q16[seg], 16);
+}
+
+/******************************************************************************/
+/*                        Public function definitions                         */
+/******************************************************************************/
+bool calib_setSpan(calibCtxt_t *me, int32_t spanCounts, int32_t spanUnits)
+{
+    uint64_t c, u, m;
+    uint8_t s = 0;
+
+    if (spanCounts == 0) {
+        return false;
+    }
+
+    c = (spanCounts < 0) ? -(int64_t)spanCounts : spanCounts;
+    u = (spanUnits < 0) ? -(int64_t)spanUnits : spanUnits;
+
+    // Largest shift that keeps u / c * 2^s below 2^31
+    while ((s < 62) && ((u << (s + 1)) < (c << 31))) {
+        s++;
+    }
+
+    for (;;) {
+        m = ((u << s) + (c >> 1)) / c;
+        if ((m < (1ULL << 31)) || (s == 0)) {
+            break;
+        }
+        s--; // rounding reached 2^31
+    }
+
+    me->mul = ((spanCounts < 0) != (spanUnits < 0)) ? -(int32_t)m : (int32_t)m;
+    me->shift = s;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool calib_setPoints(calibCtxt_t *me, const calibPoint_t *pts, uint8_t n)
+{
+    if (n == 0) {
+        me->points = 0;
+        return true;
+    }
+
+    if ((n < 2) || (n > CALIB_POINTS_MAX)) {
+        return false;
+    }
+
+    for (uint8_t i = 1; i < n; i++) {
+        if (pts[i].in <= pts[i - 1].in) {
+            return false;
+        }
+    }
+
+    for (uint8_t i = 0; i < n; i++) {
+        me->pt[i] = pts[i];
+    }
+
+    for (uint8_t i = 0; i < n - 1; i++) {
+        int64_t dOut = (int64_t)pts[i + 1].out - pts[i].out;
+        int64_t dIn = (int64_t)pts[i + 1].in - pts[i].in;
+
+        me->slope_q16[i] = (int32_t)((dOut * 65536) / dIn);
+    }
+
+    me->points = n;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int32_t calib_toUnits(const calibCtxt_t *me, int32_t counts)
+{
+    int32_t x = mulShift(counts, me->mul, me->shift);
+
+    if (me->points) {
+        x = linearize(me, x);
+    }
+
+    return x;
+}
@@ -0,0 +1,75 @@
+#ifndef _CALIB_LIB_H_
+#define _CALIB_LIB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/*
+ * Counts -> units conversion without a division per sample.
+ *
+ * calib_setSpan() turns "spanCounts counts are spanUnits units" into a
+ * reciprocal mul / 2^shift, with shift picked so that mul uses the full
+ * 31-bit range. The unit is whatever spanUnits is given in: grams,
+ * milligrams (spanUnits * 1000), ... The result is the exact quotient
+ * rounded half up, or one off from it where the exact value lies within
+ * |counts| / 2^(shift + 1) of the half-unit tie (host test in src/native).
+ *
+ * An optional piecewise-linear table then maps the linear result onto the
+ * true load to correct load cell nonlinearity. Segment slopes are computed
+ * once when the table is set.
+ */
+
+#define CALIB_POINTS_MAX    6
+
+typedef struct {
+    int32_t in;     // linear result at this load (units)
+    int32_t out;    // true load (units)
+} calibPoint_t;
+
+typedef struct {
+    int32_t mul;                                // units per count * 2^shift
+    uint8_t shift;
+    uint8_t points;                             // 0: linear only
+    calibPoint_t pt[CALIB_POINTS_MAX];          // sorted by .in
+    int32_t slope_q16[CALIB_POINTS_MAX - 1];    // d(out)/d(in) per segment
+} calibCtxt_t;
+
+/* One unit per count, no linearization */
+#define CALIB_CTXT_DEFAULTS \
+        .mul = (1L << 30), \
+        .shift = 30, \
+        .points = 0
+
+/**
+ * @fn calib_setSpan
+ * @param me         - Pointer to the calibration structure.
+ * @param spanCounts - Offset-corrected counts measured at the reference load.
+ * @param spanUnits  - Reference load in output units.
+ * @brief Precompute the reciprocal used by calib_toUnits().
+ * @return false if spanCounts is 0 (conversion left unchanged).
+ */
+bool calib_setSpan(calibCtxt_t *me, int32_t spanCounts, int32_t spanUnits);
+
+/**
+ * @fn calib_setPoints
+ * @param me     - Pointer to the calibration structure.
+ * @param pts    - Table sorted by strictly increasing .in, may be NULL if n=0.
+ * @param n      - Number of points, 0 disables linearization, 2..CALIB_POINTS_MAX.
+ * @brief Set the linearization table. Outside the table the end segments
+ *        are extended.
+ * @return false if the table is invalid (linearization left unchanged).
+ */
+bool calib_setPoints(calibCtxt_t *me, const calibPoint_t *pts, uint8_t n);
+
+/**
+ * @fn calib_toUnits
+ * @param me     - Pointer to the calibration structure.
+ * @param counts - Offset-corrected counts.
+ * @brief Convert counts to units, rounded to nearest, then linearize.
+ * @return Result in the units given to calib_setSpan().
+ */
+int32_t calib_toUnits(const calibCtxt_t *me, int32_t counts);
+
+/* _CALIB_LIB_H_ */
+#endif
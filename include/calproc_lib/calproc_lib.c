@@ -0,0 +1,121 @@
+#include "calproc_lib.h"
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+static void sortSamples(int32_t *buf, uint8_t n)
+{
+    for (uint8_t i = 1; i < n; i++) {
+        int32_t v = buf[i];
+        uint8_t j = i;
+
+        while (j && buf[j - 1] > v) {
+            buf[j] = buf[j - 1];
+            j--;
+        }
+        buf[j] = v;
+    }
+}
+
+static void evaluate(calprocCtxt_t *me)
+{
+    uint8_t lo = me->n >> 2;
+    uint8_t hi = me->n - lo;    // kept: buf[lo .. hi-1]
+    int32_t sum = 0;
+
+    sortSamples(me->buf, me->n);
+
+    if ((uint32_t)(me->buf[hi - 1] - me->buf[lo]) > (uint32_t)me->maxSpread) {
+        me->status = calproc_status_unstable;
+        return;
+    }
+
+    // Sum of offsets from buf[lo] stays small, no overflow for 24-bit input
+    for (uint8_t i = lo; i < hi; i++) {
+        sum += me->buf[i] - me->buf[lo];
+    }
+
+    me->result = me->buf[lo] + (sum + ((hi - lo) >> 1)) / (hi - lo);
+    me->status = calproc_status_done;
+}
+
+/******************************************************************************/
+/*                        Public function definitions                         */
+/******************************************************************************/
+void calproc_start(calprocCtxt_t *me, uint8_t tag, uint8_t n,
+                   int32_t maxSpread, uint16_t timeoutMs, uint32_t nowMs)
+{
+    if (n < 4) {
+        n = 4;
+    } else if (n > CALPROC_SAMPLES_MAX) {
+        n = CALPROC_SAMPLES_MAX;
+    }
+
+    me->tag = tag;
+    me->n = n;
+    me->count = 0;
+    me->maxSpread = maxSpread;
+    me->timeoutMs = timeoutMs;
+    me->startMs = nowMs;
+    me->status = calproc_status_running;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+calprocStatus_t calproc_add(calprocCtxt_t *me, int32_t raw, uint32_t nowMs)
+{
+    if (calproc_poll(me, nowMs) != calproc_status_running) {
+        return me->status;
+    }
+
+    me->buf[me->count++] = raw;
+    if (me->count >= me->n) {
+        evaluate(me);
+    }
+
+    return me->status;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+calprocStatus_t calproc_poll(calprocCtxt_t *me, uint32_t nowMs)
+{
+    if ((me->status == calproc_status_running) &&
+        (nowMs - me->startMs > me->timeoutMs)) {
+        me->status = calproc_status_timeout;
+    }
+
+    return me->status;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint8_t calproc_progress(calprocCtxt_t *me)
+{
+    if (me->status != calproc_status_running) {
+        return (me->status == calproc_status_done) ? 100 : 0;
+    }
+
+    return (uint8_t)((me->count * 100U) / me->n);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint8_t calproc_getTag(calprocCtxt_t *me)
+{
+    return me->tag;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int32_t calproc_getResult(calprocCtxt_t *me)
+{
+    return me->result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void calproc_finish(calprocCtxt_t *me)
+{
+    me->status = calproc_status_idle;
+}
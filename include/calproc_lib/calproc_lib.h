@@ -0,0 +1,109 @@
+#ifndef _CALPROC_LIB_H_
+#define _CALPROC_LIB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/*
+ * Non-blocking averaged acquisition for tare and span calibration.
+ *
+ * calproc_start() begins collecting n samples, which are then fed one by one
+ * with calproc_add() from the normal sample path, so the rest of the loop
+ * keeps running. Once n samples are in, they are sorted and a quarter is
+ * dropped from each end; the result is the mean of the middle half. The
+ * procedure fails if the middle half spreads wider than maxSpread (scale
+ * not at rest) or if it does not complete within timeoutMs.
+ */
+
+#define CALPROC_SAMPLES_MAX 16
+
+typedef enum {
+    calproc_status_idle = 0,
+    calproc_status_running,
+    calproc_status_done,        // result valid
+    calproc_status_timeout,     // not enough samples in time
+    calproc_status_unstable     // samples spread wider than maxSpread
+} calprocStatus_t;
+
+typedef struct {
+    calprocStatus_t status;
+    uint8_t tag;            // caller defined, e.g. tare or span
+
+    uint8_t n;
+    uint8_t count;
+    int32_t maxSpread;
+    uint16_t timeoutMs;
+    uint32_t startMs;
+
+    int32_t result;
+    int32_t buf[CALPROC_SAMPLES_MAX];
+} calprocCtxt_t;
+
+#define CALPROC_DECLARE_CTXT(name) \
+    calprocCtxt_t name = { \
+        .status = calproc_status_idle \
+    };
+
+/**
+ * @fn calproc_start
+ * @param me        - Pointer to the procedure context.
+ * @param tag       - Caller defined tag, returned by calproc_getTag().
+ * @param n         - Samples to average, 4..CALPROC_SAMPLES_MAX.
+ * @param maxSpread - Largest accepted peak-to-peak of the kept samples.
+ * @param timeoutMs - Give up after this long.
+ * @param nowMs     - Current time, e.g. millis().
+ * @brief Start (or restart) a procedure.
+ */
+void calproc_start(calprocCtxt_t *me, uint8_t tag, uint8_t n,
+                   int32_t maxSpread, uint16_t timeoutMs, uint32_t nowMs);
+
+/**
+ * @fn calproc_add
+ * @param me     - Pointer to the procedure context.
+ * @param raw    - Next sample.
+ * @param nowMs  - Current time, e.g. millis().
+ * @brief Feed a sample to a running procedure, also checks the timeout.
+ * @return Status after this sample.
+ */
+calprocStatus_t calproc_add(calprocCtxt_t *me, int32_t raw, uint32_t nowMs);
+
+/**
+ * @fn calproc_poll
+ * @param me     - Pointer to the procedure context.
+ * @param nowMs  - Current time, e.g. millis().
+ * @brief Check the timeout when no samples arrive.
+ * @return Current status.
+ */
+calprocStatus_t calproc_poll(calprocCtxt_t *me, uint32_t nowMs);
+
+/**
+ * @fn calproc_progress
+ * @param me     - Pointer to the procedure context.
+ * @return Collected share of the samples, 0..100 %.
+ */
+uint8_t calproc_progress(calprocCtxt_t *me);
+
+/**
+ * @fn calproc_getTag
+ * @param me     - Pointer to the procedure context.
+ * @return Tag given to calproc_start().
+ */
+uint8_t calproc_getTag(calprocCtxt_t *me);
+
+/**
+ * @fn calproc_getResult
+ * @param me     - Pointer to the procedure context.
+ * @return Trimmed mean, valid in calproc_status_done.
+ */
+int32_t calproc_getResult(calprocCtxt_t *me);
+
+/**
+ * @fn calproc_finish
+ * @param me     - Pointer to the procedure context.
+ * @brief Acknowledge a finished procedure and return to idle.
+ */
+void calproc_finish(calprocCtxt_t *me);
+
+/* _CALPROC_LIB_H_ */
+#endif
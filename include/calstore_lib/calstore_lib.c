@@ -0,0 +1,156 @@
+#include "calstore_lib.h"
+
+#include <string.h>
+#include <stddef.h>
+
+#include "crc_lib.h"
+
+/******************************************************************************/
+/*                             Internal definitions                           */
+/******************************************************************************/
+
+/* Record bytes covered by the CRC */
+#define REC_CRC_LEN     offsetof(calRecord_t, crc)
+
+/* First byte compared when checking for an unchanged record */
+#define REC_DATA_START  offsetof(calRecord_t, offset)
+
+static calRecord_t EEMEM slots[CALSTORE_SLOTS];
+
+/* Newest valid slot found by calstore_load() or written by calstore_save() */
+static int8_t curSlot = -1;
+static uint8_t curSeq;
+
+/* Save in progress, see calstore_saveStep() */
+static calRecord_t pend;
+static uint8_t pendSlot;
+static uint8_t pendPos;
+static uint8_t pendOn = 0;
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+static uint16_t recCrc(const calRecord_t *rec)
+{
+    return crc16_block(CRC16_INIT, rec, REC_CRC_LEN);
+}
+
+static bool slotValid(uint8_t slot, calRecord_t *rec)
+{
+    eeprom_read_block(rec, &slots[slot], sizeof(*rec));
+
+    return (rec->version == CALSTORE_VERSION) && (rec->crc == recCrc(rec));
+}
+
+/******************************************************************************/
+/*                        Public function definitions                         */
+/******************************************************************************/
+bool calstore_load(calRecord_t *rec)
+{
+    uint8_t version[CALSTORE_SLOTS];
+    uint8_t seq[CALSTORE_SLOTS];
+    uint8_t tried = 0;
+
+    for (uint8_t i = 0; i < CALSTORE_SLOTS; i++) {
+        version[i] = eeprom_read_byte(&slots[i].version);
+        seq[i] = eeprom_read_byte(&slots[i].seq);
+    }
+
+    // Newest first: check the CRC only on the best remaining candidate
+    while (tried != (1 << CALSTORE_SLOTS) - 1) {
+        int8_t best = -1;
+
+        for (uint8_t i = 0; i < CALSTORE_SLOTS; i++) {
+            if ((tried & (1 << i)) || (version[i] != CALSTORE_VERSION)) {
+                tried |= (1 << i);
+                continue;
+            }
+            if ((best < 0) || ((int8_t)(seq[i] - seq[best]) > 0)) {
+                best = i;
+            }
+        }
+
+        if (best < 0) {
+            break;
+        }
+
+        if (slotValid(best, rec)) {
+            curSlot = best;
+            curSeq = rec->seq;
+            return true;
+        }
+        tried |= (1 << best);
+    }
+
+    curSlot = -1;
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void calstore_save(calRecord_t *rec)
+{
+    calstore_saveStart(rec);
+
+    while (!calstore_saveStep()) {
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void calstore_saveStart(calRecord_t *rec)
+{
+    calRecord_t old;
+
+    pendOn = 0;
+
+    if ((curSlot >= 0) && slotValid(curSlot, &old) &&
+        !memcmp((const uint8_t *)rec + REC_DATA_START,
+                (const uint8_t *)&old + REC_DATA_START,
+                REC_CRC_LEN - REC_DATA_START)) {
+        *rec = old;
+        return; // unchanged, spare the EEPROM
+    }
+
+    rec->version = CALSTORE_VERSION;
+    rec->seq = (curSlot < 0) ? 0 : curSeq + 1;
+    rec->crc = recCrc(rec);
+
+    pend = *rec;
+    pendSlot = (curSlot < 0) ? 0 : (curSlot + 1) % CALSTORE_SLOTS;
+    pendPos = 0;
+    pendOn = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool calstore_saveStep(void)
+{
+    const uint8_t *src = (const uint8_t *)&pend;
+    uint8_t *dst = (uint8_t *)&slots[pendSlot];
+
+    if (!pendOn) {
+        return true;
+    }
+
+    // eeprom_write_byte() would wait for the previous write to finish
+    if (!eeprom_is_ready()) {
+        return false;
+    }
+
+    while (pendPos < sizeof(pend)) {
+        uint8_t i = pendPos++;
+
+        if (eeprom_read_byte(&dst[i]) != src[i]) {
+            eeprom_write_byte(&dst[i], src[i]);
+            return false;
+        }
+    }
+
+    // The CRC is written last of all, the slot counts from now on
+    curSlot = pendSlot;
+    curSeq = pend.seq;
+    pendOn = 0;
+
+    return true;
+}
@@ -0,0 +1,90 @@
+#ifndef _CALSTORE_LIB_H_
+#define _CALSTORE_LIB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "hal_lib.h"
+
+#include "calib_lib.h"
+
+/*
+ * Calibration record in EEPROM, rotated over CALSTORE_SLOTS slots.
+ *
+ * Every save goes to the slot after the newest one with seq + 1, so the
+ * previous record stays intact until the new one is complete and a power
+ * loss mid-write falls back to it. A slot is valid when version and CRC
+ * match; the newest valid slot is the one with the highest seq (compared
+ * modulo 256). Only changed bytes are written, and a save that does not
+ * change the record writes nothing at all.
+ *
+ * A byte write takes about 3.4 ms, a whole record a few hundred. In the
+ * main loop use calstore_saveStart() and call calstore_saveStep() from a
+ * task: it writes at most one byte per call and never waits for the EEPROM.
+ */
+
+#define CALSTORE_VERSION    3
+#define CALSTORE_SLOTS      4
+
+typedef struct {
+    uint8_t version;
+    uint8_t seq;
+
+    /* Conversion: zero and span (spanCounts counts = spanUnits units) */
+    uint32_t offset;
+    int32_t spanCounts;
+    int32_t spanUnits;
+    uint8_t points;
+    calibPoint_t pt[CALIB_POINTS_MAX];
+
+    /* Filter (xh17_setFilterParams), gain (xh17_inputSelect_t) and whether
+    the span was taken with auto-ranging (gain 128 counts) */
+    int32_t dLow;
+    int32_t dHigh;
+    uint8_t alphaMin_q8;
+    uint8_t alphaMax_q8;
+    int32_t outDeadBand;
+    uint8_t inputSelect;
+    uint8_t autoRange;
+
+    uint16_t crc;           // CRC-16/CCITT over all bytes above
+} calRecord_t;
+
+/**
+ * @fn calstore_load
+ * @param rec    - Filled with the newest valid record.
+ * @brief Find the newest valid slot. Only the headers are read until a
+ *        candidate is found, then its CRC is checked.
+ * @return false if no slot holds a valid record (rec is undefined).
+ */
+bool calstore_load(calRecord_t *rec);
+
+/**
+ * @fn calstore_save
+ * @param rec    - Record to store; version, seq and crc are filled in.
+ * @brief Write the record to the next slot. Does nothing if it equals the
+ *        newest stored record. Blocks for the EEPROM write time of the
+ *        changed bytes (about 3.4 ms each).
+ */
+void calstore_save(calRecord_t *rec);
+
+/**
+ * @fn calstore_saveStart
+ * @param rec    - Record to store; version, seq and crc are filled in. It
+ *                 is copied, rec may change while the save runs.
+ * @brief Queue the record for calstore_saveStep(), replacing a save still
+ *        in progress (that slot is left invalid, the previous one is kept).
+ *        Does nothing if it equals the newest stored record.
+ */
+void calstore_saveStart(calRecord_t *rec);
+
+/**
+ * @fn calstore_saveStep
+ * @brief Continue the queued save: skips unchanged bytes and starts at most
+ *        one byte write, only when the EEPROM is ready.
+ * @return true once no save is pending.
+ */
+bool calstore_saveStep(void);
+
+/* _CALSTORE_LIB_H_ */
+#endif
@@ -0,0 +1,160 @@
+#include "capture_lib.h"
+
+#include "usart_lib.h"
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+static inline uint8_t slot(captureCtxt_t *me, uint8_t idx)
+{
+    return (me->start + idx) % CAPTURE_SIZE;
+}
+
+static inline uint32_t absDiff(int32_t a, int32_t b)
+{
+    return (a > b) ? (uint32_t)(a - b) : (uint32_t)(b - a);
+}
+
+static void findPeak(captureCtxt_t *me)
+{
+    uint32_t best = 0;
+
+    me->peakIdx = 0;
+    for (uint8_t i = 0; i < me->fill; i++) {
+        uint32_t d = absDiff(me->buf[slot(me, i)].raw, me->base);
+
+        if (d > best) {
+            best = d;
+            me->peakIdx = i;
+        }
+    }
+}
+
+static uint8_t *putLe(uint8_t *p, uint32_t v, uint8_t bytes)
+{
+    while (bytes--) {
+        *p++ = (uint8_t)v;
+        v >>= 8;
+    }
+    return p;
+}
+
+/******************************************************************************/
+/*                        Public function definitions                         */
+/******************************************************************************/
+void capture_arm(captureCtxt_t *me, int32_t base, int32_t threshold, uint8_t pre)
+{
+    me->base = base;
+    me->threshold = threshold;
+    me->pre = (pre < CAPTURE_SIZE) ? pre : CAPTURE_SIZE - 1;
+    me->head = 0;
+    me->fill = 0;
+    me->id++;
+    me->state = capture_state_armed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void capture_cancel(captureCtxt_t *me)
+{
+    me->state = capture_state_idle;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool capture_add(captureCtxt_t *me, uint32_t timestamp, int32_t raw)
+{
+    if ((me->state != capture_state_armed) &&
+        (me->state != capture_state_triggered)) {
+        return false;
+    }
+
+    if ((me->state == capture_state_armed) &&
+        (absDiff(raw, me->base) > (uint32_t)me->threshold)) {
+        // Keep at most pre samples of history, the rest is post-trigger
+        if (me->fill > me->pre) {
+            me->fill = me->pre;
+        }
+        me->trigIdx = me->fill;
+        me->postLeft = CAPTURE_SIZE - me->fill;
+        me->state = capture_state_triggered;
+    }
+
+    me->buf[me->head].timestamp = timestamp;
+    me->buf[me->head].raw = raw;
+    me->head = (me->head + 1) % CAPTURE_SIZE;
+
+    if (me->state == capture_state_armed) {
+        if (me->fill < me->pre) {
+            me->fill++;
+        }
+        return false;
+    }
+
+    me->fill++;
+    if (--me->postLeft) {
+        return false;
+    }
+
+    me->start = (me->head + CAPTURE_SIZE - me->fill) % CAPTURE_SIZE;
+    findPeak(me);
+    me->dumpPos = 0;
+    me->state = capture_state_done;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+captureState_t capture_getState(captureCtxt_t *me)
+{
+    return me->state;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+const captureSample_t *capture_getPeak(captureCtxt_t *me)
+{
+    return &me->buf[slot(me, me->peakIdx)];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool capture_dump(captureCtxt_t *me, tlmCtxt_t *tlm)
+{
+    uint8_t payload[CAPTURE_HEADER_SIZE + CAPTURE_CHUNK * CAPTURE_SAMPLE_SIZE];
+    uint8_t *p = payload;
+    uint8_t n;
+
+    if ((me->state != capture_state_done) || (me->dumpPos >= me->fill)) {
+        return true;
+    }
+
+    n = me->fill - me->dumpPos;
+    if (n > CAPTURE_CHUNK) {
+        n = CAPTURE_CHUNK;
+    }
+
+    *p++ = me->id;
+    *p++ = me->fill;
+    *p++ = me->trigIdx;
+    *p++ = me->peakIdx;
+    *p++ = me->dumpPos;
+    *p++ = n;
+    for (uint8_t i = 0; i < n; i++) {
+        const captureSample_t *s = &me->buf[slot(me, me->dumpPos + i)];
+
+        p = putLe(p, s->timestamp, 4);
+        p = putLe(p, (uint32_t)(s->raw - TLM_RAW_ZERO), 4);
+    }
+
+    // Wait for room rather than let tlm_sendFrame() drop a chunk
+    if (USART0_TxFree() < TLM_ENCODED_MAX(TLM_HEADER_SIZE + (p - payload) + TLM_CRC_SIZE)) {
+        return false;
+    }
+
+    tlm_sendFrame(tlm, TLM_TYPE_CAPTURE, payload, p - payload);
+    me->dumpPos += n;
+
+    return me->dumpPos >= me->fill;
+}
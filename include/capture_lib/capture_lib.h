@@ -0,0 +1,126 @@
+#ifndef _CAPTURE_LIB_H_
+#define _CAPTURE_LIB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "telemetry_lib.h"
+
+/*
+ * Burst capture of raw samples around a trigger, for short impacts that the
+ * filtered stream flattens.
+ *
+ * While armed every sample goes into a ring. The first sample further than
+ * threshold from base triggers; the ring then keeps up to pre samples from
+ * before the trigger and collects the rest of CAPTURE_SIZE after it. The
+ * peak (largest |raw - base|) is computed when the capture completes.
+ *
+ * The block is sent as TLM_TYPE_CAPTURE frames of up to CAPTURE_CHUNK
+ * samples, one frame per capture_dump() call when the UART has room:
+ *   [0]    capture id
+ *   [1]    total samples
+ *   [2]    index of the trigger sample
+ *   [3]    index of the peak sample
+ *   [4]    index of the first sample in this frame
+ *   [5]    samples in this frame N
+ *   N x    timestamp u32 (micros), raw s32 (signed gain 128 counts,
+ *          raw - TLM_RAW_ZERO, see telemetry_lib)
+ */
+
+#define CAPTURE_SIZE            40
+#define CAPTURE_CHUNK           7
+
+#define CAPTURE_HEADER_SIZE     6
+#define CAPTURE_SAMPLE_SIZE     8
+
+typedef enum {
+    capture_state_idle = 0,
+    capture_state_armed,        // waiting for the trigger
+    capture_state_triggered,    // collecting post-trigger samples
+    capture_state_done          // complete, may be dumped
+} captureState_t;
+
+typedef struct {
+    uint32_t timestamp;
+    int32_t raw;
+} captureSample_t;
+
+typedef struct {
+    captureState_t state;
+    uint8_t id;
+
+    int32_t base;
+    int32_t threshold;
+    uint8_t pre;
+
+    uint8_t head;           // next ring slot
+    uint8_t fill;           // valid samples in the ring
+    uint8_t postLeft;       // samples still to take after the trigger
+    uint8_t start;          // ring slot of the first captured sample
+    uint8_t trigIdx;
+    uint8_t peakIdx;
+    uint8_t dumpPos;        // next sample to dump
+
+    captureSample_t buf[CAPTURE_SIZE];
+} captureCtxt_t;
+
+#define CAPTURE_DECLARE_CTXT(name) \
+    captureCtxt_t name = { \
+        .state = capture_state_idle, \
+        .id = 0 \
+    };
+
+/**
+ * @fn capture_arm
+ * @param me        - Pointer to the capture context.
+ * @param base      - Reference raw value, e.g. the current filtered one.
+ * @param threshold - Trigger when |raw - base| exceeds this.
+ * @param pre       - Samples to keep from before the trigger.
+ * @brief Start a new capture, discarding any previous one.
+ */
+void capture_arm(captureCtxt_t *me, int32_t base, int32_t threshold, uint8_t pre);
+
+/**
+ * @fn capture_cancel
+ * @param me     - Pointer to the capture context.
+ * @brief Return to idle.
+ */
+void capture_cancel(captureCtxt_t *me);
+
+/**
+ * @fn capture_add
+ * @param me        - Pointer to the capture context.
+ * @param timestamp - Sample time, micros().
+ * @param raw       - Raw sample.
+ * @brief Feed one sample; ignored unless armed or triggered.
+ * @return true if this sample completed the capture.
+ */
+bool capture_add(captureCtxt_t *me, uint32_t timestamp, int32_t raw);
+
+/**
+ * @fn capture_getState
+ * @param me     - Pointer to the capture context.
+ * @return Current state.
+ */
+captureState_t capture_getState(captureCtxt_t *me);
+
+/**
+ * @fn capture_getPeak
+ * @param me     - Pointer to the capture context.
+ * @return Peak sample of a completed capture.
+ */
+const captureSample_t *capture_getPeak(captureCtxt_t *me);
+
+/**
+ * @fn capture_dump
+ * @param me     - Pointer to the capture context.
+ * @param tlm    - Telemetry context used for the frames.
+ * @brief Send the next frame of a completed capture if the UART queue can
+ *        take it. Call repeatedly until it returns true.
+ * @return true when nothing (more) is left to send.
+ */
+bool capture_dump(captureCtxt_t *me, tlmCtxt_t *tlm);
+
+/* _CAPTURE_LIB_H_ */
+#endif
@@ -0,0 +1,35 @@
+#include "crc_lib.h"
+
+/******************************************************************************/
+/*                             Internal definitions                           */
+/******************************************************************************/
+
+/* Nibble table: 32 bytes of flash, two lookups per byte */
+static const uint16_t crc16_nibble[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/******************************************************************************/
+/*                        Public function definitions                         */
+/******************************************************************************/
+uint16_t crc16_update(uint16_t crc, uint8_t data)
+{
+    crc = (crc << 4) ^ crc16_nibble[((crc >> 12) ^ (data >> 4)) & 0x0F];
+    crc = (crc << 4) ^ crc16_nibble[((crc >> 12) ^ data) & 0x0F];
+
+    return crc;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint16_t crc16_block(uint16_t crc, const void *data, uint16_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+
+    while (len--) {
+        crc = crc16_update(crc, *p++);
+    }
+
+    return crc;
+}
@@ -0,0 +1,30 @@
+#ifndef _CRC_LIB_H_
+#define _CRC_LIB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* CRC-16/CCITT-FALSE: poly 0x1021, init 0xFFFF, no reflection, no xorout */
+#define CRC16_INIT 0xFFFF
+
+/**
+ * @fn crc16_update
+ * @param crc    - Running CRC value (start with CRC16_INIT).
+ * @param data   - Next byte.
+ * @brief Add one byte to a running CRC-16/CCITT.
+ * @return Updated CRC.
+ */
+uint16_t crc16_update(uint16_t crc, uint8_t data);
+
+/**
+ * @fn crc16_block
+ * @param crc    - Running CRC value (start with CRC16_INIT).
+ * @param data   - Pointer to the data.
+ * @param len    - Number of bytes.
+ * @brief Add a block of bytes to a running CRC-16/CCITT.
+ * @return Updated CRC.
+ */
+uint16_t crc16_block(uint16_t crc, const void *data, uint16_t len);
+
+/* _CRC_LIB_H_ */
+#endif
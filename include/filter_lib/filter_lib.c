@@ -0,0 +1,350 @@
+#include "filter_lib.h"
+
+#include <string.h>
+
+/******************************************************************************/
+/*                             Internal definitions                           */
+/******************************************************************************/
+
+/* Kalman variances are kept below 2^24 so that p << 8 fits 32 bits */
+#define KALMAN_VAR_MAX  0x00FFFFFFUL
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+static inline uint32_t absDiff(int32_t a, int32_t b)
+{
+    return (a > b) ? (uint32_t)(a - b) : (uint32_t)(b - a);
+}
+
+static uint16_t isqrt32(uint32_t x)
+{
+    uint32_t res = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > x) {
+        bit >>= 2;
+    }
+
+    while (bit) {
+        if (x >= res + bit) {
+            x -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return (uint16_t)res;
+}
+
+/* 1 - (1 - alpha)^(1 / 2^shift), by taking shift square roots of 1 - alpha */
+static uint8_t scaleAlpha(uint8_t alpha_q8, uint8_t shift)
+{
+    uint32_t keep_q16 = (uint32_t)(256 - alpha_q8) << 8;
+    uint32_t a;
+
+    if (!alpha_q8) {
+        return 0;
+    }
+
+    while (shift--) {
+        // sqrt of a Q16 value in Q16, 1.0 stays exactly 1.0
+        keep_q16 = (keep_q16 >= 65536UL) ? 65536UL : isqrt32(keep_q16 << 16);
+    }
+
+    a = (65536UL - keep_q16 + 128) >> 8;
+
+    return (a == 0) ? 1 : (a > 255) ? 255 : (uint8_t)a;
+}
+
+static void rescale(filterStage_t *st, uint8_t shift)
+{
+    if (st->type == filter_stage_adaptiveEma) {
+        st->ema.alphaMin_q8 = scaleAlpha(st->ema.baseMin_q8, shift);
+        st->ema.alphaMax_q8 = scaleAlpha(st->ema.baseMax_q8, shift);
+    } else if (st->type == filter_stage_kalman) {
+        st->kalman.q = st->kalman.qBase >> shift;
+        st->kalman.pLast = 0; // recompute the gain
+    }
+}
+
+static filterStage_t *addStage(filterPipe_t *me, filterStageType_t type)
+{
+    filterStage_t *st;
+
+    if (me->count >= FILTER_MAX_STAGES) {
+        return NULL;
+    }
+
+    st = &me->stage[me->count++];
+    memset(st, 0, sizeof(*st));
+    st->type = type;
+
+    return st;
+}
+
+static int32_t runMedian(filterMedian_t *f, int32_t x, uint8_t seed)
+{
+    int32_t sorted[FILTER_MEDIAN_MAX];
+
+    if (seed) {
+        for (uint8_t i = 0; i < f->size; i++) {
+            f->buf[i] = x;
+        }
+        return x;
+    }
+
+    f->buf[f->pos] = x;
+    if (++f->pos >= f->size) {
+        f->pos = 0;
+    }
+
+    // Insertion sort, N <= 5
+    for (uint8_t i = 0; i < f->size; i++) {
+        int32_t v = f->buf[i];
+        uint8_t j = i;
+
+        while (j && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+
+    return sorted[f->size >> 1];
+}
+
+static int32_t runMovingAvg(filterMovingAvg_t *f, int32_t x, uint8_t seed)
+{
+    uint8_t len = (1 << f->log2Len);
+
+    if (seed) {
+        for (uint8_t i = 0; i < len; i++) {
+            f->buf[i] = x;
+        }
+        f->sum = x << f->log2Len;
+        return x;
+    }
+
+    f->sum += x - f->buf[f->pos];
+    f->buf[f->pos] = x;
+    f->pos = (f->pos + 1) & (len - 1);
+
+    return f->sum >> f->log2Len;
+}
+
+static int32_t runAdaptiveEma(filterAdaptiveEma_t *f, int32_t x, uint8_t seed)
+{
+    uint32_t d;
+    uint8_t alpha_q8;
+
+    if (seed) {
+        f->y = x;
+        return x;
+    }
+
+    // ---- ADAPTIVE ALPHA ----
+    d = absDiff(x, f->y);
+    if (d <= (uint32_t)f->dLow) {
+        alpha_q8 = f->alphaMin_q8;
+    } else if (d >= (uint32_t)f->dHigh) {
+        alpha_q8 = f->alphaMax_q8;
+    } else {
+        uint32_t num = (d - f->dLow) * (uint32_t)(f->alphaMax_q8 - f->alphaMin_q8);
+        uint32_t den = (f->dHigh - f->dLow);
+        alpha_q8 = (uint8_t)(f->alphaMin_q8 + (num / den));
+    }
+
+    // ---- EMA UPDATE ----
+    f->y += filter_mulQ8(x - f->y, alpha_q8);
+
+    return f->y;
+}
+
+static int32_t runKalman(filterKalman_t *f, int32_t x, uint8_t seed)
+{
+    uint32_t p;
+
+    if (seed) {
+        f->x = x;
+        f->p = f->r;
+        f->pLast = 0;
+        return x;
+    }
+
+    // Predict: constant model, variance grows by q
+    p = f->p + f->q;
+    if (p > KALMAN_VAR_MAX) {
+        p = KALMAN_VAR_MAX;
+    }
+
+    // Gain converges to a fixed point, divide only while p still changes
+    if (p != f->pLast) {
+        f->k_q8 = (uint8_t)((p << 8) / (p + f->r));
+        f->pLast = p;
+    }
+
+    // Update
+    f->x += filter_mulQ8(x - f->x, f->k_q8);
+    f->p = ((256 - f->k_q8) * p) >> 8;
+
+    return f->x;
+}
+
+static int32_t runDeadBand(filterDeadBand_t *f, int32_t x, uint8_t seed)
+{
+    if (seed || absDiff(x, f->y) > (uint32_t)f->band) {
+        f->y = x; // update output only if significant change
+    }
+
+    return f->y;
+}
+
+/******************************************************************************/
+/*                        Public function definitions                         */
+/******************************************************************************/
+int32_t filter_mulQ8(int32_t x, uint8_t k_q8)
+{
+    // x = hi * 256 + lo with 0 <= lo < 256, result is exact floor
+    return (x >> 8) * k_q8 + (((x & 0xFF) * k_q8) >> 8);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void filter_init(filterPipe_t *me)
+{
+    me->count = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void filter_reset(filterPipe_t *me)
+{
+    for (uint8_t i = 0; i < me->count; i++) {
+        me->stage[i].inited = 0;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool filter_addMedian(filterPipe_t *me, uint8_t size)
+{
+    filterStage_t *st;
+
+    if (size < 3 || size > FILTER_MEDIAN_MAX || !(size & 0x01)) {
+        return false;
+    }
+
+    st = addStage(me, filter_stage_median);
+    if (!st) {
+        return false;
+    }
+    st->median.size = size;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool filter_addMovingAvg(filterPipe_t *me, uint8_t log2Len)
+{
+    filterStage_t *st;
+
+    // Range first, 1 << 16 already overflows an AVR int
+    if (log2Len > FILTER_MAVG_LOG2_MAX) {
+        return false;
+    }
+
+    st = addStage(me, filter_stage_movingAvg);
+    if (!st) {
+        return false;
+    }
+    st->mavg.log2Len = log2Len;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool filter_addAdaptiveEma(filterPipe_t *me, int32_t dLow, int32_t dHigh,
+                           uint8_t alphaMin_q8, uint8_t alphaMax_q8)
+{
+    filterStage_t *st = addStage(me, filter_stage_adaptiveEma);
+
+    if (!st) {
+        return false;
+    }
+    st->ema.dLow = dLow;
+    st->ema.dHigh = (dHigh > dLow) ? dHigh : dLow + 1;
+    st->ema.baseMin_q8 = alphaMin_q8;
+    st->ema.baseMax_q8 = (alphaMax_q8 > alphaMin_q8) ? alphaMax_q8 : alphaMin_q8;
+    rescale(st, me->rateShift);
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool filter_addKalman(filterPipe_t *me, uint32_t q, uint32_t r)
+{
+    filterStage_t *st = addStage(me, filter_stage_kalman);
+
+    if (!st) {
+        return false;
+    }
+    st->kalman.qBase = (q > KALMAN_VAR_MAX) ? KALMAN_VAR_MAX : q;
+    st->kalman.r = (r > KALMAN_VAR_MAX) ? KALMAN_VAR_MAX : (r ? r : 1);
+    rescale(st, me->rateShift);
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool filter_addDeadBand(filterPipe_t *me, int32_t band)
+{
+    filterStage_t *st = addStage(me, filter_stage_deadBand);
+
+    if (!st) {
+        return false;
+    }
+    st->deadBand.band = band;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void filter_setRate(filterPipe_t *me, uint8_t rateShift)
+{
+    me->rateShift = rateShift;
+
+    for (uint8_t i = 0; i < me->count; i++) {
+        rescale(&me->stage[i], rateShift);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int32_t filter_process(filterPipe_t *me, int32_t x)
+{
+    for (uint8_t i = 0; i < me->count; i++) {
+        filterStage_t *st = &me->stage[i];
+        uint8_t seed = !st->inited;
+
+        switch (st->type) {
+            case filter_stage_median:      x = runMedian(&st->median, x, seed); break;
+            case filter_stage_movingAvg:   x = runMovingAvg(&st->mavg, x, seed); break;
+            case filter_stage_adaptiveEma: x = runAdaptiveEma(&st->ema, x, seed); break;
+            case filter_stage_kalman:      x = runKalman(&st->kalman, x, seed); break;
+            case filter_stage_deadBand:    x = runDeadBand(&st->deadBand, x, seed); break;
+            default: break;
+        }
+
+        st->inited = 1;
+    }
+
+    return x;
+}
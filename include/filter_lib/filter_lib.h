@@ -0,0 +1,186 @@
+#ifndef _FILTER_LIB_H_
+#define _FILTER_LIB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/*
+ * Composable fixed-point filter pipeline for raw ADC counts.
+ *
+ * A pipeline is a short list of stages applied in order. Every stage keeps
+ * its state inside the pipeline structure (no heap, sizes fixed at compile
+ * time) and seeds itself from the first sample it sees. Only 32-bit
+ * arithmetic is used in filter_process(); the Kalman stage needs one 32-bit
+ * division while its gain is still converging.
+ *
+ * Stage parameters are given for the base sample rate. filter_setRate()
+ * rescales the EMA alphas and Kalman process noise for a rate 2^shift times
+ * higher, so the settling time in ms stays the same.
+ */
+
+#define FILTER_MAX_STAGES   4
+#define FILTER_MEDIAN_MAX   5   // largest median window
+#define FILTER_MAVG_LOG2_MAX 3  // largest moving average window, as log2
+#define FILTER_MAVG_MAX     (1 << FILTER_MAVG_LOG2_MAX)
+
+typedef enum {
+    filter_stage_median = 0,    // spike rejection, odd window 3..FILTER_MEDIAN_MAX
+    filter_stage_movingAvg,     // ring-buffer mean over 2^log2Len samples
+    filter_stage_adaptiveEma,   // EMA with alpha following |x - y|
+    filter_stage_kalman,        // scalar Kalman, constant state model
+    filter_stage_deadBand       // hold output until it moves by more than band
+} filterStageType_t;
+
+typedef struct {
+    uint8_t size;
+    uint8_t pos;
+    int32_t buf[FILTER_MEDIAN_MAX];
+} filterMedian_t;
+
+typedef struct {
+    uint8_t log2Len;
+    uint8_t pos;
+    int32_t sum;
+    int32_t buf[FILTER_MAVG_MAX];
+} filterMovingAvg_t;
+
+typedef struct {
+    /* Adapation thresholds for |x - y| (raw counts)
+    dLow: zone "almost noise" -> alphaMin_q8
+    dHigh: zone "large change" -> alphaMax_q8 */
+    int32_t dLow;
+    int32_t dHigh;
+    uint8_t alphaMin_q8;
+    uint8_t alphaMax_q8;
+    uint8_t baseMin_q8;     // alphas at the base rate
+    uint8_t baseMax_q8;
+    int32_t y;
+} filterAdaptiveEma_t;
+
+typedef struct {
+    uint32_t q;         // process noise variance, counts^2
+    uint32_t qBase;     // q at the base rate
+    uint32_t r;         // measurement noise variance, counts^2
+    uint32_t p;         // estimate variance, counts^2 (kept below 2^24)
+    uint32_t pLast;     // p the cached gain was computed for
+    uint8_t k_q8;       // Kalman gain, Q8
+    int32_t x;
+} filterKalman_t;
+
+typedef struct {
+    int32_t band;
+    int32_t y;
+} filterDeadBand_t;
+
+typedef struct {
+    filterStageType_t type;
+    uint8_t inited;
+    union {
+        filterMedian_t median;
+        filterMovingAvg_t mavg;
+        filterAdaptiveEma_t ema;
+        filterKalman_t kalman;
+        filterDeadBand_t deadBand;
+    };
+} filterStage_t;
+
+typedef struct {
+    uint8_t count;
+    uint8_t rateShift;      // sample rate is base rate * 2^rateShift
+    filterStage_t stage[FILTER_MAX_STAGES];
+} filterPipe_t;
+
+/**
+ * @fn filter_init
+ * @param me     - Pointer to the filter pipeline.
+ * @brief Remove all stages.
+ */
+void filter_init(filterPipe_t *me);
+
+/**
+ * @fn filter_reset
+ * @param me     - Pointer to the filter pipeline.
+ * @brief Keep the configuration, forget the state; the next sample seeds
+ *        every stage.
+ */
+void filter_reset(filterPipe_t *me);
+
+/**
+ * @fn filter_addMedian
+ * @param me     - Pointer to the filter pipeline.
+ * @param size   - Odd window size, 3..FILTER_MEDIAN_MAX.
+ * @brief Append a median-of-N spike rejection stage.
+ * @return false if the pipeline is full or the size invalid.
+ */
+bool filter_addMedian(filterPipe_t *me, uint8_t size);
+
+/**
+ * @fn filter_addMovingAvg
+ * @param me      - Pointer to the filter pipeline.
+ * @param log2Len - Window of 2^log2Len samples, up to FILTER_MAVG_LOG2_MAX.
+ * @brief Append a moving average stage.
+ * @return false if the pipeline is full or the length invalid.
+ */
+bool filter_addMovingAvg(filterPipe_t *me, uint8_t log2Len);
+
+/**
+ * @fn filter_addAdaptiveEma
+ * @param me           - Pointer to the filter pipeline.
+ * @param dLow         - Below this |x - y| alphaMin_q8 is used.
+ * @param dHigh        - Above this |x - y| alphaMax_q8 is used.
+ * @param alphaMin_q8  - Minimum alpha value in Q8 format.
+ * @param alphaMax_q8  - Maximum alpha value in Q8 format.
+ * @brief Append an adaptive EMA stage, alpha is interpolated in between.
+ * @return false if the pipeline is full.
+ */
+bool filter_addAdaptiveEma(filterPipe_t *me, int32_t dLow, int32_t dHigh,
+                           uint8_t alphaMin_q8, uint8_t alphaMax_q8);
+
+/**
+ * @fn filter_addKalman
+ * @param me     - Pointer to the filter pipeline.
+ * @param q      - Process noise variance (counts^2), how fast weight moves.
+ * @param r      - Measurement noise variance (counts^2), < 2^24.
+ * @brief Append a scalar Kalman filter stage.
+ * @return false if the pipeline is full.
+ */
+bool filter_addKalman(filterPipe_t *me, uint32_t q, uint32_t r);
+
+/**
+ * @fn filter_addDeadBand
+ * @param me     - Pointer to the filter pipeline.
+ * @param band   - Output changes only when the input moves more than this.
+ * @brief Append a dead-band stage.
+ * @return false if the pipeline is full.
+ */
+bool filter_addDeadBand(filterPipe_t *me, int32_t band);
+
+/**
+ * @fn filter_setRate
+ * @param me        - Pointer to the filter pipeline.
+ * @param rateShift - Sample rate is the base rate * 2^rateShift (0..3).
+ * @brief Rescale time constants: alpha' = 1 - (1 - alpha)^(1/2^rateShift),
+ *        q' = q / 2^rateShift. Filter state is kept.
+ */
+void filter_setRate(filterPipe_t *me, uint8_t rateShift);
+
+/**
+ * @fn filter_process
+ * @param me     - Pointer to the filter pipeline.
+ * @param x      - Input sample.
+ * @brief Run one sample through all stages.
+ * @return Output of the last stage (x itself if there are no stages).
+ */
+int32_t filter_process(filterPipe_t *me, int32_t x);
+
+/**
+ * @fn filter_mulQ8
+ * @param x      - Value, |x| < 2^31 / 256 * 256.
+ * @param k_q8   - Factor in Q8.
+ * @brief floor(x * k_q8 / 256) without a 64-bit product.
+ */
+int32_t filter_mulQ8(int32_t x, uint8_t k_q8);
+
+/* _FILTER_LIB_H_ */
+#endif
@@ -0,0 +1,131 @@
+#include "fmt_lib.h"
+
+/******************************************************************************/
+/*                             Internal definitions                           */
+/******************************************************************************/
+
+/* Digits are found by repeated subtraction: AVR has no divide instruction,
+every 32-bit division printf makes is a libgcc shift-and-subtract loop. AVR
+cycles of both come from the simavr harness, "pio run -e sim_fmt". */
+static const uint32_t pow10[10] = {
+    1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+    10000UL, 1000UL, 100UL, 10UL, 1UL
+};
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+
+/* Write all 10 decimal digits of value (leading zeros included) */
+static void toDigits(uint32_t value, char *digits)
+{
+    for (uint8_t i = 0; i < 10; i++) {
+        uint32_t p = pow10[i];
+        char d = '0';
+
+        while (value >= p) {
+            value -= p;
+            d++;
+        }
+        digits[i] = d;
+    }
+}
+
+/* Index of the first significant digit, never past the last one */
+static uint8_t firstDigit(const char *digits)
+{
+    uint8_t i = 0;
+
+    while (i < 9 && digits[i] == '0') {
+        i++;
+    }
+
+    return i;
+}
+
+/******************************************************************************/
+/*                        Public function definitions                         */
+/******************************************************************************/
+uint8_t fmt_u32(char *buf, uint32_t value)
+{
+    char digits[10];
+    uint8_t n = 0;
+
+    toDigits(value, digits);
+
+    for (uint8_t i = firstDigit(digits); i < 10; i++) {
+        buf[n++] = digits[i];
+    }
+    buf[n] = '\0';
+
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint8_t fmt_i32(char *buf, int32_t value)
+{
+    if (value < 0) {
+        *buf = '-';
+        return 1 + fmt_u32(buf + 1, -(uint32_t)value);
+    }
+
+    return fmt_u32(buf, (uint32_t)value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint8_t fmt_fixed(char *buf, int32_t value, uint8_t fracDigits,
+                  uint8_t fracShown, uint8_t intWidth, char point)
+{
+    char digits[10];
+    uint32_t mag = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+    uint8_t intEnd;     // index of the first fractional digit
+    uint8_t i;
+    uint8_t n = 0;
+
+    if (fracDigits > 9) {
+        fracDigits = 9;
+    }
+    if (fracShown > fracDigits) {
+        fracShown = fracDigits;
+    }
+
+    toDigits(mag, digits);
+    intEnd = 10 - fracDigits;
+
+    // Sign only if something non-zero survives the truncation
+    for (i = 0; i < intEnd + fracShown; i++) {
+        if (value < 0 && digits[i] != '0') {
+            buf[n++] = '-';
+            break;
+        }
+    }
+
+    i = firstDigit(digits);
+    if (i > intEnd - 1) {
+        i = intEnd - 1;         // keep one integer digit
+    }
+    if (intWidth > intEnd) {
+        intWidth = intEnd;
+    }
+    if (intEnd - i < intWidth) {
+        i = intEnd - intWidth;  // zero padding
+    }
+
+    while (i < intEnd) {
+        buf[n++] = digits[i++];
+    }
+
+    if (fracShown && point) {
+        buf[n++] = point;
+    }
+
+    while (fracShown--) {
+        buf[n++] = digits[i++];
+    }
+
+    buf[n] = '\0';
+
+    return n;
+}
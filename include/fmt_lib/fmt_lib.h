@@ -0,0 +1,50 @@
+#ifndef _FMT_LIB_H_
+#define _FMT_LIB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Buffer size that fits any int32_t in decimal plus sign and terminator */
+#define FMT_I32_BUF_SIZE    12
+
+/* Buffer size for fmt_fixed(): digits, sign, point and terminator */
+#define FMT_FIXED_BUF_SIZE  14
+
+/**
+ * @fn fmt_u32
+ * @param buf    - Output buffer, at least FMT_I32_BUF_SIZE bytes.
+ * @param value  - Value to render.
+ * @brief Render an unsigned value in decimal, NUL terminated.
+ * @return Number of characters written (without the terminator).
+ */
+uint8_t fmt_u32(char *buf, uint32_t value);
+
+/**
+ * @fn fmt_i32
+ * @param buf    - Output buffer, at least FMT_I32_BUF_SIZE bytes.
+ * @param value  - Value to render.
+ * @brief Render a signed value in decimal, NUL terminated. Same output as
+ *        snprintf("%ld").
+ * @return Number of characters written (without the terminator).
+ */
+uint8_t fmt_i32(char *buf, int32_t value);
+
+/**
+ * @fn fmt_fixed
+ * @param buf        - Output buffer, at least FMT_FIXED_BUF_SIZE bytes.
+ * @param value      - Fixed-point value in units of 10^-fracDigits.
+ * @param fracDigits - Number of fractional digits in value (0..9).
+ * @param fracShown  - Number of fractional digits to print, the rest is
+ *                     truncated toward zero (fracShown <= fracDigits).
+ * @param intWidth   - Minimum integer digits, zero padded.
+ * @param point      - Decimal separator, '\0' to print none (7-segment
+ *                     displays without a DP segment).
+ * @brief Render a signed fixed-point value without printf.
+ *        e.g. fmt_fixed(buf, 1234, 3, 2, 2, '\0') -> "0123" (1.234 kg).
+ * @return Number of characters written (without the terminator).
+ */
+uint8_t fmt_fixed(char *buf, int32_t value, uint8_t fracDigits,
+                  uint8_t fracShown, uint8_t intWidth, char point);
+
+/* _FMT_LIB_H_ */
+#endif
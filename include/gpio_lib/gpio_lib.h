@@ -0,0 +1,54 @@
+#ifndef _GPIO_LIB_H_
+#define _GPIO_LIB_H_
+
+#include <stdint.h>
+#include "hal_lib.h"
+
+/*
+ * Compile-time GPIO pins.
+ *
+ * GPIO_DECLARE_PIN(name, PORTx, bit) generates static inline accessors
+ * name_setHigh(), name_setLow(), name_setOutput(), name_setInput() and
+ * name_read(). Port and bit are constants, so avr-gcc emits a single
+ * sbi/cbi/sbic/sbis for each access instead of the pointer + runtime
+ * shift sequence needed by a "volatile uint8_t *port, uint8_t bit" pair.
+ *
+ * The accessors cost what the instruction set manual gives for sbi/cbi
+ * (2 cycles) and sbic/sbis (1..3 cycles). The pointer + bit path and
+ * Arduino's digitalWrite() depend on the compiler and core version, so
+ * they are measured rather than quoted here: the "sim_gpio" build times a
+ * set + clear pair through each of the three paths on PB5, and the simavr
+ * harness prints them in cycles ("pin inline", "pin pointer+bit",
+ * "pin digitalWrite"), next to the whole "HX711 readout" and
+ * "tm1637_print" regions:
+ *   pio run -e sim_gpio && make -C pc/simavr run FIRMWARE=../../.pio/build/sim_gpio/firmware.elf
+ *
+ * Drivers turn these accessors into a per-instance "pins" table from their
+ * DECLARE macros, so the hot transaction (e.g. the HX711 shift-in) runs with
+ * constant addresses. Called through the table, every entry into it is an
+ * indirect call (icall, plus the saves it forces on an ISR); the ISR bodies
+ * are also generated per instance (name_irqHandler(), name_tick()), which
+ * pass the table as a constant so the compiler inlines the accessors.
+ *
+ * HAL_PORT_WRITTEN() compiles to nothing on the target; in the native build
+ * it lets a device model (HX711, TM1637) react to the pin changes.
+ */
+
+/* DDR register is PORT - 1, PIN register is PORT - 2 */
+#define GPIO_DDR(port)  (*(&(port) - 1))
+#define GPIO_PIN(port)  (*(&(port) - 2))
+
+#define GPIO_DECLARE_PIN(name, port, bit) \
+    static inline __attribute__((always_inline)) void name##_setHigh(void) \
+    { (port) |= (uint8_t)(1 << (bit)); HAL_PORT_WRITTEN(port); } \
+    static inline __attribute__((always_inline)) void name##_setLow(void) \
+    { (port) &= (uint8_t)~(1 << (bit)); HAL_PORT_WRITTEN(port); } \
+    static inline __attribute__((always_inline)) void name##_setOutput(void) \
+    { GPIO_DDR(port) |= (uint8_t)(1 << (bit)); HAL_PORT_WRITTEN(GPIO_DDR(port)); } \
+    static inline __attribute__((always_inline)) void name##_setInput(void) \
+    { GPIO_DDR(port) &= (uint8_t)~(1 << (bit)); HAL_PORT_WRITTEN(GPIO_DDR(port)); } \
+    static inline __attribute__((always_inline)) uint8_t name##_read(void) \
+    { return (GPIO_PIN(port) & (1 << (bit))) ? 1 : 0; }
+
+/* _GPIO_LIB_H_ */
+#endif
@@ -0,0 +1,62 @@
+#ifndef _HAL_LIB_H_
+#define _HAL_LIB_H_
+
+/*
+ * Hardware abstraction for the drivers under include/.
+ *
+ * On the target this is just the avr-libc headers. A host build (PlatformIO
+ * "native" env) gets hal_native.h instead: the ATmega328P I/O registers live
+ * in a RAM array at their data-space addresses, delays advance a virtual
+ * clock, ISR() bodies become plain functions the host program calls, and
+ * EEMEM variables stay in RAM.
+ *
+ * Drivers include this header instead of <avr/...> and <util/...>.
+ */
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+#if defined(__AVR__)
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <util/delay.h>
+
+/* Notify the host model of a GPIO register write, nothing on the target */
+#define HAL_PORT_WRITTEN(reg)   do { } while (0)
+
+#else
+
+#include "hal_native.h"
+
+#define HAL_PORT_WRITTEN(reg)   hal_native_portWritten(&(reg))
+
+#endif
+
+/*
+ * Region markers for the simavr harness (pc/simavr). With SIM_MARKERS the
+ * id is written to GPIOR0 at the start of a region and id | HAL_MARK_END at
+ * its end, one "out" instruction each; the simulator timestamps the writes.
+ * Without SIM_MARKERS (the normal builds) they compile to nothing.
+ */
+#define HAL_MARK_XH17_READ      1   // HX711 data bits + gain pulses
+#define HAL_MARK_TM1637_PRINT   2   // tm1637_print() call
+#define HAL_MARK_TLM_FRAME      3   // tlm_sendFrame(), encode + queue
+#define HAL_MARK_FMT            4   // fmt_fixed() of the displayed weight
+#define HAL_MARK_FMT_REF        5   // same string by snprintf, SIM_FMT_REF only
+#define HAL_MARK_GPIO_INLINE    6   // pin set + clear, SIM_GPIO_REF only:
+#define HAL_MARK_GPIO_PTR       7   //   GPIO_DECLARE_PIN, pointer + bit index
+#define HAL_MARK_GPIO_ARDUINO   8   //   and digitalWrite()
+
+#define HAL_MARK_END            0x80
+
+#if defined(SIM_MARKERS)
+#define HAL_MARK(id)            (GPIOR0 = (uint8_t)(id))
+#else
+#define HAL_MARK(id)            do { } while (0)
+#endif
+
+/* _HAL_LIB_H_ */
+#endif
@@ -0,0 +1,124 @@
+#include "hal_lib.h"
+
+/* The target build gets everything from avr-libc */
+#if !defined(__AVR__)
+
+#include <string.h>
+
+/******************************************************************************/
+/*                             Internal definitions                           */
+/******************************************************************************/
+
+volatile uint8_t hal_sfr[HAL_SFR_SIZE];
+
+static hal_portHook_t portHook;
+static uint64_t timeNs;
+static uint32_t eepromWrites;
+
+/******************************************************************************/
+/*                         Public function definitions                        */
+/******************************************************************************/
+void hal_native_reset(void)
+{
+    memset((void *)hal_sfr, 0, sizeof(hal_sfr));
+    UCSR0A = (1 << UDRE0);
+    timeNs = 0;
+    eepromWrites = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void hal_native_setPortHook(hal_portHook_t hook)
+{
+    portHook = hook;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void hal_native_portWritten(volatile uint8_t *reg)
+{
+    if (portHook) {
+        portHook(reg);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void hal_native_delayUs(double us)
+{
+    if (us > 0) {
+        timeNs += (uint64_t)(us * 1000.0 + 0.5);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint64_t hal_native_timeNs(void)
+{
+    return timeNs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint32_t hal_native_eepromWrites(void)
+{
+    return eepromWrites;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+    return *addr;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value)
+{
+    *addr = value;
+    eepromWrites++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value)
+{
+    if (*addr != value) {
+        eeprom_write_byte(addr, value);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void eeprom_read_block(void *dst, const void *src, size_t len)
+{
+    memcpy(dst, src, len);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void eeprom_write_block(const void *src, void *dst, size_t len)
+{
+    const uint8_t *s = src;
+    uint8_t *d = dst;
+
+    while (len--) {
+        eeprom_write_byte(d++, *s++);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void eeprom_update_block(const void *src, void *dst, size_t len)
+{
+    const uint8_t *s = src;
+    uint8_t *d = dst;
+
+    while (len--) {
+        eeprom_update_byte(d++, *s++);
+    }
+}
+
+/* !__AVR__ */
+#endif
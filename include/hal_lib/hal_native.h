@@ -0,0 +1,294 @@
+#ifndef _HAL_NATIVE_H_
+#define _HAL_NATIVE_H_
+
+/*
+ * Host model of the ATmega328P used by the "native" build, included through
+ * hal_lib.h only. Register names, bit numbers and vector names match
+ * avr-libc, so the drivers compile unchanged.
+ *
+ * Registers are plain bytes: a write to PORTx does not show up in PINx unless
+ * a port hook (hal_native_setPortHook) models the attached device, and status
+ * flags only change when the host program sets them.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+/******************************************************************************/
+/*                               I/O registers                                */
+/******************************************************************************/
+
+/* Data-space addresses 0x00..0xFF, registers and extended I/O */
+#define HAL_SFR_SIZE    0x100
+
+extern volatile uint8_t hal_sfr[HAL_SFR_SIZE];
+
+#define _SFR_MEM8(addr)     (hal_sfr[(addr)])
+#define _SFR_MEM16(addr)    (*(volatile uint16_t *)&hal_sfr[(addr)])
+
+#define PINB    _SFR_MEM8(0x23)
+#define DDRB    _SFR_MEM8(0x24)
+#define PORTB   _SFR_MEM8(0x25)
+#define PINC    _SFR_MEM8(0x26)
+#define DDRC    _SFR_MEM8(0x27)
+#define PORTC   _SFR_MEM8(0x28)
+#define PIND    _SFR_MEM8(0x29)
+#define DDRD    _SFR_MEM8(0x2A)
+#define PORTD   _SFR_MEM8(0x2B)
+#define TIFR0   _SFR_MEM8(0x35)
+#define TIFR1   _SFR_MEM8(0x36)
+#define TIFR2   _SFR_MEM8(0x37)
+#define PCIFR   _SFR_MEM8(0x3B)
+#define EIFR    _SFR_MEM8(0x3C)
+#define EIMSK   _SFR_MEM8(0x3D)
+#define GPIOR0  _SFR_MEM8(0x3E)
+#define TCCR0A  _SFR_MEM8(0x44)
+#define TCCR0B  _SFR_MEM8(0x45)
+#define TCNT0   _SFR_MEM8(0x46)
+#define GPIOR1  _SFR_MEM8(0x4A)
+#define GPIOR2  _SFR_MEM8(0x4B)
+#define SPCR    _SFR_MEM8(0x4C)
+#define SPSR    _SFR_MEM8(0x4D)
+#define SPDR    _SFR_MEM8(0x4E)
+#define SREG    _SFR_MEM8(0x5F)
+#define PCICR   _SFR_MEM8(0x68)
+#define EICRA   _SFR_MEM8(0x69)
+#define PCMSK0  _SFR_MEM8(0x6B)
+#define PCMSK1  _SFR_MEM8(0x6C)
+#define PCMSK2  _SFR_MEM8(0x6D)
+#define TIMSK0  _SFR_MEM8(0x6E)
+#define TIMSK1  _SFR_MEM8(0x6F)
+#define TIMSK2  _SFR_MEM8(0x70)
+#define TCCR1A  _SFR_MEM8(0x80)
+#define TCCR1B  _SFR_MEM8(0x81)
+#define TCCR1C  _SFR_MEM8(0x82)
+#define TCNT1   _SFR_MEM16(0x84)
+#define OCR1A   _SFR_MEM16(0x88)
+#define TCCR2A  _SFR_MEM8(0xB0)
+#define TCCR2B  _SFR_MEM8(0xB1)
+#define TCNT2   _SFR_MEM8(0xB2)
+#define OCR2A   _SFR_MEM8(0xB3)
+#define UCSR0A  _SFR_MEM8(0xC0)
+#define UCSR0B  _SFR_MEM8(0xC1)
+#define UCSR0C  _SFR_MEM8(0xC2)
+#define UBRR0L  _SFR_MEM8(0xC4)
+#define UBRR0H  _SFR_MEM8(0xC5)
+#define UDR0    _SFR_MEM8(0xC6)
+
+/* Port bits */
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+/* SREG */
+#define SREG_I  7
+
+/* External and pin change interrupts */
+#define ISC00   0
+#define ISC01   1
+#define ISC10   2
+#define ISC11   3
+#define INT0    0
+#define INT1    1
+#define INTF0   0
+#define INTF1   1
+#define PCIE0   0
+#define PCIE1   1
+#define PCIE2   2
+#define PCIF0   0
+#define PCIF1   1
+#define PCIF2   2
+
+/* Timer 0 */
+#define CS00    0
+#define CS01    1
+#define CS02    2
+#define TOIE0   0
+#define OCIE0A  1
+#define TOV0    0
+
+/* Timer 1 */
+#define CS10    0
+#define CS11    1
+#define CS12    2
+#define WGM12   3
+#define TOIE1   0
+#define OCIE1A  1
+#define TOV1    0
+
+/* Timer 2 */
+#define WGM20   0
+#define WGM21   1
+#define CS20    0
+#define CS21    1
+#define CS22    2
+#define OCIE2A  1
+#define OCF2A   1
+
+/* SPI */
+#define SPR0    0
+#define SPR1    1
+#define CPHA    2
+#define CPOL    3
+#define MSTR    4
+#define DORD    5
+#define SPE     6
+#define SPIE    7
+#define SPI2X   0
+#define WCOL    6
+#define SPIF    7
+
+/* USART 0 */
+#define MPCM0   0
+#define U2X0    1
+#define UPE0    2
+#define DOR0    3
+#define FE0     4
+#define UDRE0   5
+#define TXC0    6
+#define RXC0    7
+#define TXB80   0
+#define RXB80   1
+#define UCSZ02  2
+#define TXEN0   3
+#define RXEN0   4
+#define UDRIE0  5
+#define TXCIE0  6
+#define RXCIE0  7
+#define UCPOL0  0
+#define UCSZ00  1
+#define UCPHA0  1
+#define UCSZ01  2
+#define UDORD0  2
+#define USBS0   3
+#define UPM00   4
+#define UPM01   5
+#define UMSEL00 6
+#define UMSEL01 7
+
+/******************************************************************************/
+/*                                 Interrupts                                 */
+/******************************************************************************/
+
+/* An ISR is an ordinary function; the host program raises an interrupt by
+calling it, e.g. HAL_ISR_CALL(TIMER0_OVF_vect) */
+#define ISR(vector, ...)        void vector(void)
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define HAL_ISR_CALL(vector)    vector()
+
+#define INT0_vect           hal_vect_INT0
+#define INT1_vect           hal_vect_INT1
+#define PCINT0_vect         hal_vect_PCINT0
+#define PCINT1_vect         hal_vect_PCINT1
+#define PCINT2_vect         hal_vect_PCINT2
+#define TIMER2_COMPA_vect   hal_vect_TIMER2_COMPA
+#define TIMER1_OVF_vect     hal_vect_TIMER1_OVF
+#define TIMER0_OVF_vect     hal_vect_TIMER0_OVF
+#define USART_RX_vect       hal_vect_USART_RX
+#define USART_UDRE_vect     hal_vect_USART_UDRE
+
+void INT0_vect(void);
+void INT1_vect(void);
+void PCINT0_vect(void);
+void PCINT1_vect(void);
+void PCINT2_vect(void);
+void TIMER2_COMPA_vect(void);
+void TIMER1_OVF_vect(void);
+void TIMER0_OVF_vect(void);
+void USART_RX_vect(void);
+void USART_UDRE_vect(void);
+
+/* Only the I flag is modelled, so saving and restoring SREG works as usual */
+#define sei()   (SREG |= (uint8_t)(1 << SREG_I))
+#define cli()   (SREG &= (uint8_t)~(1 << SREG_I))
+
+/******************************************************************************/
+/*                                   Delays                                   */
+/******************************************************************************/
+
+#define _delay_us(us)   hal_native_delayUs(us)
+#define _delay_ms(ms)   hal_native_delayUs((ms) * 1000.0)
+
+/******************************************************************************/
+/*                                   EEPROM                                   */
+/******************************************************************************/
+
+/* EEMEM variables are ordinary RAM on the host, writes complete at once */
+#define EEMEM
+#define eeprom_is_ready()   1
+
+uint8_t eeprom_read_byte(const uint8_t *addr);
+void eeprom_write_byte(uint8_t *addr, uint8_t value);
+void eeprom_update_byte(uint8_t *addr, uint8_t value);
+void eeprom_read_block(void *dst, const void *src, size_t len);
+void eeprom_write_block(const void *src, void *dst, size_t len);
+void eeprom_update_block(const void *src, void *dst, size_t len);
+
+/******************************************************************************/
+/*                              Host model control                            */
+/******************************************************************************/
+
+/* Called after every GPIO_DECLARE_PIN write with the PORTx or DDRx register */
+typedef void (*hal_portHook_t)(volatile uint8_t *reg);
+
+/**
+ * @fn hal_native_reset
+ * @brief Clear all registers to their reset values, set the USART data
+ *        register empty flag, zero the virtual clock and EEPROM write count.
+ */
+void hal_native_reset(void);
+
+/**
+ * @fn hal_native_setPortHook
+ * @param hook - Device model called on GPIO writes, NULL to remove it.
+ */
+void hal_native_setPortHook(hal_portHook_t hook);
+
+/**
+ * @fn hal_native_portWritten
+ * @param reg - Register that was just written.
+ * @brief Used by HAL_PORT_WRITTEN(), forwards to the port hook.
+ */
+void hal_native_portWritten(volatile uint8_t *reg);
+
+/**
+ * @fn hal_native_delayUs
+ * @param us - Delay length.
+ * @brief Advance the virtual clock, returns immediately.
+ */
+void hal_native_delayUs(double us);
+
+/**
+ * @fn hal_native_timeNs
+ * @return Virtual time spent in _delay_us()/_delay_ms() since the last reset.
+ */
+uint64_t hal_native_timeNs(void);
+
+/**
+ * @fn hal_native_eepromWrites
+ * @return Number of EEPROM bytes actually written since the last reset.
+ */
+uint32_t hal_native_eepromWrites(void);
+
+/* _HAL_NATIVE_H_ */
+#endif
@@ -5,23 +5,12 @@
 #define F_CPU 16000000UL
 #endif
 
-#include <avr/io.h>
-#include <avr/interrupt.h>
+#include "hal_lib.h"
+#include "time_lib.h"
 
-#define CLOCK_CYCLES_PER_USEC() ( F_CPU / 1000000L )
-
-#define CLOCK_CYCLES_TO_USEC(a) ( (a) / CLOCK_CYCLES_PER_USEC() )
-
-#define MICROSECONDS_PER_TIMER0_OVERFLOW (CLOCK_CYCLES_TO_USEC(64 * 256))
-
-// the whole number of milliseconds per timer0 overflow
-#define MILLIS_INC (MICROSECONDS_PER_TIMER0_OVERFLOW / 1000)
-
-// the fractional number of milliseconds per timer0 overflow. we shift right
-// by three to fit these numbers into a byte. (for the clock speeds we care
-// about - 8 and 16 MHz - this doesn't lose precision.)
-#define FRACT_INC ((MICROSECONDS_PER_TIMER0_OVERFLOW % 1000) >> 3)
-#define FRACT_MAX (1000 >> 3)
+// Arduino style API over time_lib, which owns Timer0 and its overflow ISR.
+// Both are 32 bit and wrap: micros() after 71.6 minutes, millis() after
+// 49.7 days. Use time_ticks() for timestamps that must not wrap.
 
 void millis_init();
 
@@ -0,0 +1,135 @@
+#include "prof_lib.h"
+
+#include <string.h>
+
+#include "usart_lib.h"
+
+/******************************************************************************/
+/*                             Internal definitions                           */
+/******************************************************************************/
+#define PROF_PAYLOAD_SIZE   (2 + PROF_REGIONS * PROF_ENTRY_SIZE)
+
+#if PROF_PAYLOAD_SIZE > TLM_PAYLOAD_MAX
+#error "Profile table does not fit into one telemetry frame"
+#endif
+
+static profEntry_t table[PROF_REGIONS];
+static uint8_t overhead;
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+static uint8_t *putLe(uint8_t *p, uint32_t v, uint8_t n)
+{
+    while (n--) {
+        *p++ = (uint8_t)v;
+        v >>= 8;
+    }
+
+    return p;
+}
+
+static void clearEntry(profEntry_t *e)
+{
+    e->count = 0;
+    e->min = UINT16_MAX;
+    e->max = 0;
+    e->sum = 0;
+}
+
+/******************************************************************************/
+/*                         Public function definitions                        */
+/******************************************************************************/
+void prof_init(void)
+{
+    uint16_t t0;
+
+    TCCR1A = 0x00;
+    TCCR1B = (1 << CS10);   // no prescaler, normal mode
+    TIMSK1 = 0x00;
+
+    // Back to back reads: what PROF_BEGIN/PROF_END add to every sample
+    t0 = prof_now();
+    overhead = (uint8_t)(prof_now() - t0);
+
+    prof_reset();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void prof_record(profRegion_t region, uint16_t cycles)
+{
+    profEntry_t *e = &table[region];
+
+    cycles = (cycles > overhead) ? cycles - overhead : 0;
+
+    if ((e->count == UINT16_MAX) || (e->sum > UINT32_MAX - UINT16_MAX)) {
+        e->count >>= 1;
+        e->sum >>= 1;
+    }
+
+    e->count++;
+    e->sum += cycles;
+    if (cycles < e->min) {
+        e->min = cycles;
+    }
+    if (cycles > e->max) {
+        e->max = cycles;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void prof_get(profRegion_t region, profEntry_t *entry)
+{
+    uint8_t old_SREG = SREG;
+
+    cli();
+    *entry = table[region];
+    SREG = old_SREG;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void prof_reset(void)
+{
+    uint8_t old_SREG = SREG;
+
+    cli();
+    for (uint8_t i = 0; i < PROF_REGIONS; i++) {
+        clearEntry(&table[i]);
+    }
+    SREG = old_SREG;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool prof_dump(tlmCtxt_t *tlm)
+{
+    uint8_t payload[PROF_PAYLOAD_SIZE];
+    uint8_t *p = payload;
+
+    if (USART0_TxFree() < TLM_ENCODED_MAX(TLM_HEADER_SIZE + PROF_PAYLOAD_SIZE + TLM_CRC_SIZE)) {
+        return false;
+    }
+
+    *p++ = PROF_REGIONS;
+    *p++ = overhead;
+    for (uint8_t i = 0; i < PROF_REGIONS; i++) {
+        profEntry_t e;
+        uint8_t old_SREG = SREG;
+
+        // Take and clear in one step, the ISR regions keep counting
+        cli();
+        e = table[i];
+        clearEntry(&table[i]);
+        SREG = old_SREG;
+
+        p = putLe(p, e.count, 2);
+        p = putLe(p, e.count ? e.min : 0, 2);
+        p = putLe(p, e.max, 2);
+        p = putLe(p, e.sum, 4);
+    }
+
+    return tlm_sendFrame(tlm, TLM_TYPE_PROFILE, payload, p - payload);
+}
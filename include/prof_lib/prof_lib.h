@@ -0,0 +1,111 @@
+#ifndef _PROF_LIB_H_
+#define _PROF_LIB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "hal_lib.h"
+#include "telemetry_lib.h"
+
+/*
+ * Cycle profiler for the hot paths.
+ *
+ * Timer1 runs free at F_CPU (62.5 ns per tick at 16 MHz) and is not used for
+ * anything else. PROF_BEGIN()/PROF_END() around a region read TCNT1 and
+ * record the difference in a static table of count / min / max / sum per
+ * region. The cost of the timer reads is measured in prof_init() and
+ * subtracted. Regions must be shorter than 65536 cycles (4.096 ms), longer
+ * ones wrap.
+ *
+ * prof_dump() sends the table as a TLM_TYPE_PROFILE frame and clears it:
+ *   [0]    number of regions N
+ *   [1]    timer read overhead subtracted per sample, cycles
+ *   N x    count u16, min u16, max u16, sum u32 (cycles)
+ * When count or sum would overflow both are halved, so the mean stays valid.
+ *
+ * Set PROF_EN to 0 to compile the markers out.
+ */
+#ifndef PROF_EN
+#define PROF_EN                 1
+#endif
+
+#define PROF_ENTRY_SIZE         10
+
+typedef enum {
+    prof_region_read = 0,   // HX711 readout, PCINT ISR
+    prof_region_filter,     // xh17_filter()
+    prof_region_format,     // fmt_fixed() of the displayed weight
+    prof_region_display,    // tm1637_print()
+    prof_region_uart,       // telemetry sample / frame queueing
+    PROF_REGIONS
+} profRegion_t;
+
+typedef struct {
+    uint16_t count;
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+} profEntry_t;
+
+/* TCNT1 is read through the shared TEMP register, an ISR reading it between
+the two byte accesses would corrupt the high byte */
+static inline uint16_t prof_now(void)
+{
+    uint8_t old_SREG = SREG;
+    uint16_t t;
+
+    cli();
+    t = TCNT1;
+    SREG = old_SREG;
+
+    return t;
+}
+
+#if PROF_EN
+#define PROF_BEGIN(region)  uint16_t prof_t0_##region = prof_now()
+#define PROF_END(region)    prof_record((region), prof_now() - prof_t0_##region)
+#else
+#define PROF_BEGIN(region)  do { } while (0)
+#define PROF_END(region)    do { } while (0)
+#endif
+
+/**
+ * @fn prof_init
+ * @brief Start Timer1 at F_CPU without interrupts, measure the marker
+ *        overhead and clear the table.
+ */
+void prof_init(void);
+
+/**
+ * @fn prof_record
+ * @param region - Region the time belongs to.
+ * @param cycles - Raw TCNT1 difference, used by PROF_END().
+ * @brief Add one measurement to the table. Each region must be recorded
+ *        from one context only (main loop or one ISR).
+ */
+void prof_record(profRegion_t region, uint16_t cycles);
+
+/**
+ * @fn prof_get
+ * @param region - Region to read.
+ * @param entry  - Where to store a consistent copy of its statistics.
+ */
+void prof_get(profRegion_t region, profEntry_t *entry);
+
+/**
+ * @fn prof_reset
+ * @brief Clear the statistics of all regions.
+ */
+void prof_reset(void);
+
+/**
+ * @fn prof_dump
+ * @param tlm - Telemetry context used to send the frame.
+ * @brief Send the table as a TLM_TYPE_PROFILE frame and clear it.
+ * @return false if the UART queue had no room, nothing was sent or cleared.
+ */
+bool prof_dump(tlmCtxt_t *tlm);
+
+/* _PROF_LIB_H_ */
+#endif
@@ -0,0 +1,36 @@
+#ifndef _SCALES_CONFIG_H_
+#define _SCALES_CONFIG_H_
+
+/*
+ * Settings of the sample path shared by the firmware (src/main.c) and the
+ * host programs that replay it (src/replay, src/native), so a replayed trace
+ * runs with the thresholds the scale runs with.
+ */
+
+/* Counts are gain 128 counts (auto-ranging scales gain 64 samples to them).
+
+Stable when the raw spread stays within the band for the hold time, unstable
+again once it exceeds the wider leave band. Both are wider at 80 SPS where
+the HX711 is noisier */
+#define STABLE_BAND_COUNTS        4000
+#define STABLE_BAND_COUNTS_80SPS  8000
+#define STABLE_LEAVE_COUNTS       8000
+#define STABLE_LEAVE_COUNTS_80SPS 16000
+#define STABLE_HOLD_MS           500
+
+/* 1: 80 SPS while the load moves, 10 SPS once stable */
+#define ADAPTIVE_RATE      1
+
+/* Auto zero tracking: band around zero and max offset step per sample */
+#define AZT_BAND_COUNTS    3000
+#define AZT_STEP_COUNTS    8
+
+/* Task periods in ms, the sample task runs in the background (sched_lib) */
+#define TASK_DISPLAY_MS    200
+#define TASK_TELEMETRY_MS  250
+#define TASK_CAPTURE_MS    10
+#define TASK_COMMAND_MS    50
+#define TASK_CALSTORE_MS   5    // > one EEPROM byte write (3.4 ms)
+
+/* _SCALES_CONFIG_H_ */
+#endif
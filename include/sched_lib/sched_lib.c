@@ -0,0 +1,98 @@
+#include "sched_lib.h"
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+static inline bool isDue(const schedTask_t *t, timeTicks_t now)
+{
+    return t->periodMs && (now >= t->nextRun);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void runTask(schedTask_t *t)
+{
+    uint32_t start, runUs;
+
+    start = time_ticks32();
+    t->fn();
+    runUs = (time_ticks32() - start) * TIME_US_PER_TICK;
+
+    if (runUs > UINT16_MAX) {
+        runUs = UINT16_MAX;
+    }
+    if (runUs > t->maxRunUs) {
+        t->maxRunUs = (uint16_t)runUs;
+    }
+    if (t->budgetUs && runUs > t->budgetUs) {
+        t->overruns++;
+    }
+    t->runs++;
+}
+
+/******************************************************************************/
+/*                        Public function definitions                         */
+/******************************************************************************/
+void sched_init(schedTask_t *tasks, uint8_t count)
+{
+    timeTicks_t now = time_ticks();
+
+    for (uint8_t i = 0; i < count; i++) {
+        tasks[i].nextRun = now;
+    }
+
+    sched_resetStats(tasks, count);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool sched_run(schedTask_t *tasks, uint8_t count)
+{
+    timeTicks_t now = time_ticks();
+    schedTask_t *best = NULL;
+    bool ran = false;
+
+    for (uint8_t i = 0; i < count; i++) {
+        schedTask_t *t = &tasks[i];
+
+        if (isDue(t, now) && (!best || t->priority > best->priority)) {
+            best = t;
+        }
+    }
+
+    if (best) {
+        timeTicks_t period = time_msToTicks(best->periodMs);
+
+        best->nextRun += period;
+        if (isDue(best, now)) {
+            // Fell a whole period behind: skip, don't run a burst to catch up
+            best->lateRuns++;
+            best->nextRun = now + period;
+        }
+
+        runTask(best);
+        return true;
+    }
+
+    // Nothing periodic due: background tasks
+    for (uint8_t i = 0; i < count; i++) {
+        if (!tasks[i].periodMs) {
+            runTask(&tasks[i]);
+            ran = true;
+        }
+    }
+
+    return ran;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void sched_resetStats(schedTask_t *tasks, uint8_t count)
+{
+    for (uint8_t i = 0; i < count; i++) {
+        tasks[i].maxRunUs = 0;
+        tasks[i].overruns = 0;
+        tasks[i].lateRuns = 0;
+        tasks[i].runs = 0;
+    }
+}
@@ -0,0 +1,78 @@
+#ifndef _SCHED_LIB_H_
+#define _SCHED_LIB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "time_lib.h"
+
+/*
+ * Cooperative scheduler over a static task table.
+ *
+ * Each call to sched_run() starts at most one periodic task: the highest
+ * priority one whose deadline has passed, ties going to the earlier table
+ * entry. Deadlines are time_ticks() values, which don't wrap. Tasks with
+ * periodMs 0 are background tasks: a pass with no periodic task due runs
+ * each of them once instead, so an always-ready task can't starve the
+ * periodic ones and still runs whenever the CPU is otherwise idle. Tasks
+ * run to completion, so a long low-priority task delays the next sample by
+ * at most its own runtime, which is what maxRunUs shows.
+ */
+
+typedef struct {
+    void (*fn)(void);
+    uint16_t periodMs;      // 0 = background, runs on every idle pass
+    uint8_t priority;       // higher value runs first, unused for background
+    uint16_t budgetUs;      // runtime above this is an overrun, 0 = no limit
+
+    timeTicks_t nextRun;    // time_ticks() deadline
+    uint16_t maxRunUs;      // worst runtime seen
+    uint16_t overruns;      // runs longer than budgetUs
+    uint16_t lateRuns;      // deadline missed by a whole period or more
+    uint32_t runs;
+} schedTask_t;
+
+#define SCHED_TASK(func, period, prio, budget) \
+    { \
+        .fn = (func), \
+        .periodMs = (period), \
+        .priority = (prio), \
+        .budgetUs = (budget), \
+        .nextRun = 0, \
+        .maxRunUs = 0, \
+        .overruns = 0, \
+        .lateRuns = 0, \
+        .runs = 0 \
+    }
+
+#define SCHED_TASK_COUNT(table) ((uint8_t)(sizeof(table) / sizeof((table)[0])))
+
+/**
+ * @fn sched_init
+ * @param tasks  - Task table.
+ * @param count  - Number of tasks in the table.
+ * @brief Make every task due now and clear the statistics.
+ */
+void sched_init(schedTask_t *tasks, uint8_t count);
+
+/**
+ * @fn sched_run
+ * @param tasks  - Task table.
+ * @param count  - Number of tasks in the table.
+ * @brief Run the most urgent due periodic task or, if none is due, the
+ *        background tasks.
+ * @return true if a task was run.
+ */
+bool sched_run(schedTask_t *tasks, uint8_t count);
+
+/**
+ * @fn sched_resetStats
+ * @param tasks  - Task table.
+ * @param count  - Number of tasks in the table.
+ * @brief Clear maxRunUs/overruns/lateRuns/runs of all tasks.
+ */
+void sched_resetStats(schedTask_t *tasks, uint8_t count);
+
+/* _SCHED_LIB_H_ */
+#endif
@@ -0,0 +1,102 @@
+#include "stable_lib.h"
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+/* Over the fill samples held, win[0..fill-1] while filling */
+static uint32_t peakToPeak(stableCtxt_t *me)
+{
+    int32_t lo = me->win[0];
+    int32_t hi = me->win[0];
+
+    for (uint8_t i = 1; i < me->fill; i++) {
+        if (me->win[i] < lo) {
+            lo = me->win[i];
+        }
+        if (me->win[i] > hi) {
+            hi = me->win[i];
+        }
+    }
+
+    return (uint32_t)(hi - lo);
+}
+
+/******************************************************************************/
+/*                        Public function definitions                         */
+/******************************************************************************/
+bool stable_update(stableCtxt_t *me, int32_t raw, uint32_t nowMs)
+{
+    me->win[me->pos] = raw;
+    me->pos = (me->pos + 1) % STABLE_WINDOW;
+
+    if (me->fill < STABLE_WINDOW) {
+        me->fill++;
+    }
+
+    // Motion shows in a partial window too, settling needs a full one
+    if (peakToPeak(me) > (uint32_t)(me->stable ? me->leaveBand : me->band)) {
+        if (me->stable) {
+            me->motionSince = nowMs;
+        }
+        me->stable = 0;
+        me->inBand = 0;
+    } else if (me->fill < STABLE_WINDOW) {
+        return me->stable;
+    } else if (!me->inBand) {
+        me->inBand = 1;
+        me->inBandSince = nowMs;
+    }
+
+    if (me->inBand && !me->stable && (nowMs - me->inBandSince >= me->holdMs)) {
+        me->stable = 1;
+        me->timeToStable = nowMs - me->motionSince;
+    }
+
+    return me->stable;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool stable_isStable(stableCtxt_t *me)
+{
+    return me->stable;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint32_t stable_timeToStable(stableCtxt_t *me)
+{
+    return me->timeToStable;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stable_setBand(stableCtxt_t *me, int32_t band, int32_t leaveBand)
+{
+    me->band = band;
+    me->leaveBand = leaveBand;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stable_restart(stableCtxt_t *me)
+{
+    // Keep the newest sample, a step right at the switch is still seen
+    if (me->fill) {
+        me->win[0] = me->win[(me->pos + STABLE_WINDOW - 1) % STABLE_WINDOW];
+        me->fill = 1;
+    }
+    me->pos = me->fill;
+    me->inBand = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void stable_reset(stableCtxt_t *me, uint32_t nowMs)
+{
+    me->fill = 0;
+    me->pos = 0;
+    me->stable = 0;
+    me->inBand = 0;
+    me->motionSince = nowMs;
+}
@@ -0,0 +1,106 @@
+#ifndef _STABLE_LIB_H_
+#define _STABLE_LIB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/*
+ * Motion / stability detector.
+ *
+ * The peak-to-peak spread of the last STABLE_WINDOW raw samples is compared
+ * against band. The reading is declared stable once the spread has stayed
+ * inside the band for holdMs, and unstable on the first window exceeding
+ * leaveBand, a partly filled one too. leaveBand is the wider one, so a
+ * spread near the band does not toggle the state (and the 10/80 SPS switch
+ * that follows it).
+ * timeToStable is the time from that first motion to the next stable state.
+ */
+
+#define STABLE_WINDOW   8
+
+typedef struct {
+    int32_t band;           // max peak-to-peak to become stable, raw counts
+    int32_t leaveBand;      // peak-to-peak that ends stable, >= band
+    uint16_t holdMs;        // time the spread must stay inside band
+
+    int32_t win[STABLE_WINDOW];
+    uint8_t pos;
+    uint8_t fill;
+
+    uint8_t stable;
+    uint8_t inBand;
+    uint32_t inBandSince;   // ms timestamp the spread went inside band
+    uint32_t motionSince;   // ms timestamp stable was lost
+    uint32_t timeToStable;  // ms from motion to stable, last settle
+} stableCtxt_t;
+
+#define STABLE_DECLARE_CTXT(name, bandCounts, leaveCounts, holdTimeMs) \
+    stableCtxt_t name = { \
+        .band = (bandCounts), \
+        .leaveBand = (leaveCounts), \
+        .holdMs = (holdTimeMs), \
+        .pos = 0, \
+        .fill = 0, \
+        .stable = 0, \
+        .inBand = 0, \
+        .inBandSince = 0, \
+        .motionSince = 0, \
+        .timeToStable = 0 \
+    };
+
+/**
+ * @fn stable_update
+ * @param me     - Pointer to the stability detector.
+ * @param raw    - Next raw sample.
+ * @param nowMs  - Time the sample was taken in ms, e.g. its ISR timestamp.
+ * @brief Add a sample and re-evaluate the stable state.
+ * @return true if the reading is stable.
+ */
+bool stable_update(stableCtxt_t *me, int32_t raw, uint32_t nowMs);
+
+/**
+ * @fn stable_isStable
+ * @param me     - Pointer to the stability detector.
+ * @return true if the reading is stable.
+ */
+bool stable_isStable(stableCtxt_t *me);
+
+/**
+ * @fn stable_timeToStable
+ * @param me     - Pointer to the stability detector.
+ * @return Time in ms the last settle took, from the first motion sample.
+ */
+uint32_t stable_timeToStable(stableCtxt_t *me);
+
+/**
+ * @fn stable_setBand
+ * @param me        - Pointer to the stability detector.
+ * @param band      - Max peak-to-peak to become stable, raw counts.
+ * @param leaveBand - Peak-to-peak that ends stable, raw counts, >= band.
+ * @brief Change the bands, e.g. for a sample rate with different noise.
+ */
+void stable_setBand(stableCtxt_t *me, int32_t band, int32_t leaveBand);
+
+/**
+ * @fn stable_restart
+ * @param me     - Pointer to the stability detector.
+ * @brief Forget the window but the newest sample and keep the stable
+ *        state, e.g. at a sample rate switch: the old samples have the other
+ *        rate's noise. The state is re-evaluated once the window is full
+ *        again.
+ */
+void stable_restart(stableCtxt_t *me);
+
+/**
+ * @fn stable_reset
+ * @param me     - Pointer to the stability detector.
+ * @param nowMs  - Current time, e.g. millis().
+ * @brief Forget the window and start as unstable (e.g. after a tare). Call
+ *        it once before the first sample too, the first timeToStable counts
+ *        from nowMs.
+ */
+void stable_reset(stableCtxt_t *me, uint32_t nowMs);
+
+/* _STABLE_LIB_H_ */
+#endif
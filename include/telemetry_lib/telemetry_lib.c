@@ -0,0 +1,127 @@
+#include "telemetry_lib.h"
+
+#include <string.h>
+
+#include "hal_lib.h"
+#include "crc_lib.h"
+#include "usart_lib.h"
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+static uint8_t *putLe(uint8_t *p, uint32_t v, uint8_t bytes)
+{
+    while (bytes--) {
+        *p++ = (uint8_t)v;
+        v >>= 8;
+    }
+
+    return p;
+}
+
+/******************************************************************************/
+/*                        Public function definitions                         */
+/******************************************************************************/
+uint8_t tlm_cobsEncode(const uint8_t *src, uint8_t len, uint8_t *dst)
+{
+    uint8_t *code = dst;
+    uint8_t *out = dst + 1;
+    uint8_t run = 1;
+
+    while (len--) {
+        uint8_t b = *src++;
+
+        if (b) {
+            *out++ = b;
+            run++;
+        }
+
+        if (!b || run == 0xFF) {
+            *code = run;
+            code = out++;
+            run = 1;
+        }
+    }
+
+    *code = run;
+    *out++ = 0x00;
+
+    return (uint8_t)(out - dst);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool tlm_sendFrame(tlmCtxt_t *me, uint8_t type, const uint8_t *payload, uint8_t len)
+{
+    uint8_t frame[TLM_FRAME_MAX];
+    uint8_t encoded[TLM_ENCODED_MAX(TLM_FRAME_MAX)];
+    uint8_t n = 0;
+    uint16_t crc;
+
+    if (len > TLM_PAYLOAD_MAX) {
+        return false;
+    }
+
+    HAL_MARK(HAL_MARK_TLM_FRAME);
+
+    frame[n++] = (TLM_VERSION << 4) | (type & 0x0F);
+    frame[n++] = me->seq++;
+    memcpy(&frame[n], payload, len);
+    n += len;
+
+    crc = crc16_block(CRC16_INIT, frame, n);
+    frame[n++] = (uint8_t)crc;
+    frame[n++] = (uint8_t)(crc >> 8);
+
+    n = tlm_cobsEncode(frame, n, encoded);
+
+    // A partial frame is worse than none, the host would have to resync
+    if (USART0_TxFree() < n) {
+        if (me->framesDropped < UINT16_MAX) {
+            me->framesDropped++;
+        }
+        HAL_MARK(HAL_MARK_TLM_FRAME | HAL_MARK_END);
+        return false;
+    }
+
+    USART0_Write(encoded, n);
+    HAL_MARK(HAL_MARK_TLM_FRAME | HAL_MARK_END);
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool tlm_addSample(tlmCtxt_t *me, const tlmSample_t *s)
+{
+    uint8_t *p = &me->payload[1 + me->count * TLM_SAMPLE_SIZE];
+
+    p = putLe(p, (uint32_t)s->timestamp, 4);
+    p = putLe(p, (uint32_t)(s->timestamp >> 32), 2);
+    p = putLe(p, (uint32_t)(s->raw - TLM_RAW_ZERO), 4);
+    p = putLe(p, (uint32_t)(s->filtered - TLM_RAW_ZERO), 4);
+    p = putLe(p, (uint32_t)s->units, 4);
+    *p = s->flags;
+
+    if (++me->count < me->batch && me->count < TLM_BATCH_MAX) {
+        return false;
+    }
+
+    tlm_flush(me);
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void tlm_flush(tlmCtxt_t *me)
+{
+    if (!me->count) {
+        return;
+    }
+
+    me->payload[0] = me->count;
+    tlm_sendFrame(me, TLM_TYPE_SAMPLES, me->payload,
+                  1 + me->count * TLM_SAMPLE_SIZE);
+    me->count = 0;
+}
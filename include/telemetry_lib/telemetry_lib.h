@@ -0,0 +1,120 @@
+#ifndef _TELEMETRY_LIB_H_
+#define _TELEMETRY_LIB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/*
+ * Binary telemetry frames over USART0.
+ *
+ * Frame before encoding (multi-byte fields little endian):
+ *   [0]    header: protocol version (high nibble) | frame type (low nibble)
+ *   [1]    sequence counter, +1 per frame
+ *   [2..]  type specific payload
+ *   [n-2]  CRC-16/CCITT-FALSE over [0 .. n-3]
+ *
+ * The frame is COBS encoded and terminated by a single 0x00 byte, so a
+ * receiver can resynchronise on any zero after a corrupted byte.
+ *
+ * TLM_TYPE_SAMPLES payload:
+ *   [0]    number of samples N
+ *   N x    timestamp u48 (us since start, see time_lib), raw s32,
+ *          filtered s32, units s32, flags u8
+ *
+ * raw and filtered are signed counts, 0 at zero differential input: the
+ * xh17 values are offset binary (count ^ 0x800000) and are sent minus
+ * TLM_RAW_ZERO. They take 32 bits, auto-ranged gain 64 readings are scaled
+ * to gain 128 counts and go past the 24 bits of the HX711.
+ *
+ * Sample flags:
+ *   bit 0  TLM_FLAG_STABLE, reading has settled (see stable_lib)
+ */
+#define TLM_VERSION             4   // 4: signed 32-bit raw and filtered
+
+#define TLM_TYPE_SAMPLES        1
+#define TLM_TYPE_CAPTURE        2   // burst capture block, see capture_lib
+#define TLM_TYPE_TRACE          3   // raw sample trace block, see trace_lib
+#define TLM_TYPE_PROFILE        4   // cycle profile table, see prof_lib
+
+#define TLM_FLAG_STABLE         (1 << 0)
+
+/* xh17 offset binary value of a zero count */
+#define TLM_RAW_ZERO            0x800000L
+
+#define TLM_SAMPLE_SIZE         19
+#define TLM_BATCH_MAX           4
+
+#define TLM_HEADER_SIZE         2
+#define TLM_CRC_SIZE            2
+#define TLM_PAYLOAD_MAX         (1 + TLM_BATCH_MAX * TLM_SAMPLE_SIZE)
+#define TLM_FRAME_MAX           (TLM_HEADER_SIZE + TLM_PAYLOAD_MAX + TLM_CRC_SIZE)
+
+/* COBS adds one byte per 254 plus the leading code byte, then the delimiter */
+#define TLM_ENCODED_MAX(len)    ((len) + ((len) / 254) + 2)
+
+typedef struct {
+    uint64_t timestamp;     // time_us() when the sample was taken
+    int32_t raw;            // raw counts, offset binary as read by xh17
+    int32_t filtered;       // filtered counts, offset binary
+    int32_t units;          // filtered value after offset/scale
+    uint8_t flags;          // TLM_FLAG_*
+} tlmSample_t;
+
+typedef struct {
+    uint8_t seq;
+    uint8_t batch;          // samples per frame, 1..TLM_BATCH_MAX
+    uint8_t count;          // samples waiting in payload
+    uint16_t framesDropped; // frames that didn't fit into the UART queue
+
+    uint8_t payload[TLM_PAYLOAD_MAX];
+} tlmCtxt_t;
+
+#define TLM_DECLARE_CTXT(name, batchSize) \
+    tlmCtxt_t name = { \
+        .seq = 0, \
+        .batch = (batchSize), \
+        .count = 0, \
+        .framesDropped = 0 \
+    };
+
+/**
+ * @fn tlm_addSample
+ * @param me     - Pointer to the telemetry context structure.
+ * @param s      - Sample to append to the current batch.
+ * @brief Append a sample; the frame is sent once the batch is full.
+ * @return true if a frame was sent (or dropped) by this call.
+ */
+bool tlm_addSample(tlmCtxt_t *me, const tlmSample_t *s);
+
+/**
+ * @fn tlm_flush
+ * @param me     - Pointer to the telemetry context structure.
+ * @brief Send the pending samples now, even if the batch is not full.
+ */
+void tlm_flush(tlmCtxt_t *me);
+
+/**
+ * @fn tlm_sendFrame
+ * @param me      - Pointer to the telemetry context structure.
+ * @param type    - Frame type (TLM_TYPE_*).
+ * @param payload - Frame payload.
+ * @param len     - Payload length, at most TLM_PAYLOAD_MAX.
+ * @brief Build, encode and queue one frame. The frame is dropped as a whole
+ *        (and counted) if the UART queue can't take it.
+ * @return true if the frame was queued.
+ */
+bool tlm_sendFrame(tlmCtxt_t *me, uint8_t type, const uint8_t *payload, uint8_t len);
+
+/**
+ * @fn tlm_cobsEncode
+ * @param src    - Data to encode.
+ * @param len    - Data length.
+ * @param dst    - Output, at least TLM_ENCODED_MAX(len) bytes.
+ * @brief COBS encode src and append the 0x00 delimiter.
+ * @return Number of bytes written to dst.
+ */
+uint8_t tlm_cobsEncode(const uint8_t *src, uint8_t len, uint8_t *dst);
+
+/* _TELEMETRY_LIB_H_ */
+#endif
@@ -0,0 +1,127 @@
+#include "time_lib.h"
+
+/******************************************************************************/
+/*                             Internal definitions                           */
+/******************************************************************************/
+#define US_PER_OVF      (256UL * TIME_US_PER_TICK)
+
+// Whole milliseconds per overflow and the rest in units of 8 us; the overflow
+// period is a multiple of 256 us, so the fraction fits a byte exactly
+#define MS_INC          (US_PER_OVF / 1000)
+#define FRACT_INC       ((US_PER_OVF % 1000) >> 3)
+#define FRACT_MAX       (1000 >> 3)
+
+static volatile uint8_t seq;        // +1 per ISR update, see readCounter()
+static volatile uint32_t ovfLo;     // overflow count, low 32 bits
+static volatile uint8_t ovfHi;      // overflow count, bits 32..39
+static volatile uint32_t msCount;
+static uint8_t msFract;             // ISR only
+
+ISR(TIMER0_OVF_vect)
+{
+    uint32_t m = msCount + MS_INC;
+    uint8_t f = msFract + FRACT_INC;
+    uint32_t lo = ovfLo + 1;
+
+    if (f >= FRACT_MAX) {
+        f -= FRACT_MAX;
+        m++;
+    }
+
+    msFract = f;
+    msCount = m;
+    ovfLo = lo;
+    if (!lo) {
+        ovfHi++;
+    }
+    seq++;
+}
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+
+/* Overflow count and TCNT0 of one instant without cli(). The ISR is the only
+writer and can't be interrupted by a reader, so one sequence bump per update
+is enough: a read it cut into sees seq change and starts over. */
+static inline uint8_t readCounter(uint32_t *lo, uint8_t *hi)
+{
+    uint8_t s;
+    uint8_t t;
+    bool pending;
+
+    do {
+        s = seq;
+        *lo = ovfLo;
+        *hi = ovfHi;
+        t = TCNT0;
+        // Overflow not serviced yet (interrupts off): TCNT0 already wrapped
+        pending = (TIFR0 & (1 << TOV0)) && (t < 255);
+    } while (s != seq);
+
+    if (pending && !++*lo) {
+        (*hi)++;
+    }
+
+    return t;
+}
+
+/******************************************************************************/
+/*                         Public function definitions                        */
+/******************************************************************************/
+void time_init(void)
+{
+    TCCR0A = 0x00;
+    TCCR0B = (1 << CS01) | (1 << CS00);     // F_CPU / 64, normal mode
+    TCNT0 = 0x00;
+    TIMSK0 = (1 << TOIE0);
+
+    sei();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+timeTicks_t time_ticks(void)
+{
+    uint32_t lo;
+    uint8_t hi;
+    uint8_t t = readCounter(&lo, &hi);
+
+    return ((timeTicks_t)hi << 40) | ((timeTicks_t)lo << 8) | t;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint32_t time_ticks32(void)
+{
+    uint32_t lo;
+    uint8_t hi;
+    uint8_t t = readCounter(&lo, &hi);
+
+    return (lo << 8) | t;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+timeTicks_t time_extend(uint32_t ticks32)
+{
+    timeTicks_t now = time_ticks();
+
+    // Age of the stamp, modulo 2^32 like the stamp itself
+    return now - (uint32_t)((uint32_t)now - ticks32);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint32_t time_ms(void)
+{
+    uint32_t m;
+    uint8_t s;
+
+    do {
+        s = seq;
+        m = msCount;
+    } while (s != seq);
+
+    return m;
+}
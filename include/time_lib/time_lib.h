@@ -0,0 +1,114 @@
+#ifndef _TIME_LIB_H_
+#define _TIME_LIB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "hal_lib.h"
+
+/*
+ * Monotonic time base on Timer0.
+ *
+ * Timer0 runs at F_CPU / 64 and one count is a tick (4 us at 16 MHz). The
+ * overflow ISR, every 256 ticks (1.024 ms), advances a 40-bit overflow
+ * counter and the millisecond counter; together with TCNT0 that is a 48-bit
+ * tick count, which wraps after about 35 years at 16 MHz.
+ *
+ * Readers don't disable interrupts. The ISR bumps a sequence number with
+ * every update and a reader retries when the number changed under it, so the
+ * HX711 and display ISRs are never held off by a time read. An overflow that
+ * is pending while interrupts are off (inside an ISR) is accounted for from
+ * TOV0, like in micros().
+ *
+ * The conversion helpers are shifts and constant multiplies. Ticks to
+ * milliseconds would take a division by 250, time_ms() is the millisecond
+ * clock instead.
+ */
+#define TIME_PRESCALER          64
+#define TIME_US_PER_TICK        (TIME_PRESCALER / (F_CPU / 1000000UL))
+#define TIME_TICKS_PER_MS       (1000UL / TIME_US_PER_TICK)
+
+#if (TIME_US_PER_TICK == 0) || (TIME_PRESCALER % (F_CPU / 1000000UL)) || \
+    (1000 % TIME_US_PER_TICK)
+#error "time_lib needs F_CPU of 8, 16, 32 or 64 MHz"
+#endif
+
+/* 48 significant bits, kept in a uint64_t */
+typedef uint64_t timeTicks_t;
+
+/**
+ * @fn time_init
+ * @brief Start Timer0 at F_CPU / 64 with the overflow interrupt and enable
+ *        interrupts.
+ */
+void time_init(void);
+
+/**
+ * @fn time_ticks
+ * @return Ticks since time_init(), 48 bits, never wraps in practice.
+ */
+timeTicks_t time_ticks(void);
+
+/**
+ * @fn time_ticks32
+ * @return Low 32 bits of time_ticks() (wraps after 4.77 h at 16 MHz), for
+ *         short intervals; cheaper, no 64-bit arithmetic.
+ */
+uint32_t time_ticks32(void);
+
+/**
+ * @fn time_extend
+ * @param ticks32 - time_ticks32() value taken within the last 4.77 h, e.g.
+ *                  in an ISR.
+ * @return The same instant as a full time_ticks() value.
+ */
+timeTicks_t time_extend(uint32_t ticks32);
+
+/**
+ * @fn time_ms
+ * @return Milliseconds since time_init(), 32 bits (wraps after 49.7 days).
+ */
+uint32_t time_ms(void);
+
+/**
+ * @fn time_ticksToUs
+ * @param ticks - Tick count or interval.
+ * @return The same in microseconds.
+ */
+static inline uint64_t time_ticksToUs(timeTicks_t ticks)
+{
+    return ticks * TIME_US_PER_TICK;
+}
+
+/**
+ * @fn time_usToTicks
+ * @param us - Microseconds.
+ * @return Whole ticks in us, rounded down.
+ */
+static inline timeTicks_t time_usToTicks(uint64_t us)
+{
+    return us / TIME_US_PER_TICK;
+}
+
+/**
+ * @fn time_msToTicks
+ * @param ms - Milliseconds.
+ * @return The same in ticks.
+ */
+static inline timeTicks_t time_msToTicks(uint32_t ms)
+{
+    return (timeTicks_t)ms * TIME_TICKS_PER_MS;
+}
+
+/**
+ * @fn time_us
+ * @return Microseconds since time_init(), 48+ bits.
+ */
+static inline uint64_t time_us(void)
+{
+    return time_ticksToUs(time_ticks());
+}
+
+/* _TIME_LIB_H_ */
+#endif
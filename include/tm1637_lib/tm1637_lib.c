@@ -21,107 +21,172 @@
 /******************************************************************************/
 /*                        Static function definitions                         */
 /******************************************************************************/
-static void clkSet_high(tm1637Ctxt_t *me)
+static void tm1617_start(tm1637Ctxt_t *me)
 {
-    *(me->clkPORT) |= (1 << me->clkBIT);
-}
+    const tm1637Pins_t *pins = me->pins;
 
-static void clkSet_low(tm1637Ctxt_t *me)
-{
-    *(me->clkPORT) &= ~(1 << me->clkBIT);
-}
+    pins->dioSetOutput(1);
 
-static void clkPulse(tm1637Ctxt_t *me)
-{
-    clkSet_high(me);
-    TM16_DELAY_US(5);
-    clkSet_low(me);
-    TM16_DELAY_US(5);
+    pins->dioSet(1);
+    pins->clkSet(1);
+    TM16_DELAY_US(2);
+    pins->dioSet(0);
+    TM16_DELAY_US(2);
+    pins->clkSet(0);
 }
 
-static void dioSet_high(tm1637Ctxt_t *me)
+static void tm1617_stop(tm1637Ctxt_t *me)
 {
-    *(me->dioPORT) |= (1 << me->dioBIT);
-}
+    const tm1637Pins_t *pins = me->pins;
 
-static void dioSet_low(tm1637Ctxt_t *me)
-{
-    *(me->dioPORT) &= ~(1 << me->dioBIT);
-}
+    pins->dioSetOutput(1);
 
-static void dioSet_input(tm1637Ctxt_t *me)
-{
-    *(me->dioDDR) &= ~(1 << me->dioBIT);
+    pins->clkSet(0);
+    pins->dioSet(0);
+    TM16_DELAY_US(2);
+    pins->clkSet(1);
+    TM16_DELAY_US(2);
+    pins->dioSet(1);
+    TM16_DELAY_US(2);
 }
 
-static void dioSet_output(tm1637Ctxt_t *me)
+static bool tm1617_writeByte(tm1637Ctxt_t *me, uint8_t data)
 {
-    *(me->dioDDR) |= (1 << me->dioBIT);
+    if (!me->pins->writeByte(data)) {
+        me->status = tm1637_status_ackError;
+        me->ackErrors++;
+        return false;
+    }
+
+    return true;
 }
 
-static uint8_t dioRead(tm1637Ctxt_t *me)
+static void tm1637_waitIdle(tm1637Ctxt_t *me)
 {
-    return (*(me->dioPIN) & (1 << me->dioBIT)) ? 1 : 0;
+    while (me->busy);
 }
 
-static void tm1617_start(tm1637Ctxt_t *me)
+/* Bus script of a frame update: transactions stored as [len][len bytes],
+terminated by a zero length. Fixed address mode costs 1 + 2 bytes per
+changed digit, auto-increment 2 + all digits; the cheaper one is used. */
+static void buildScript(tm1637Ctxt_t *me, const uint8_t *frame, uint8_t dirty, uint8_t *script)
 {
-    dioSet_output(me);
+    uint8_t changed = 0;
+    uint8_t n = 0;
 
-    dioSet_high(me);
-    clkSet_high(me);
-    TM16_DELAY_US(2);
-    dioSet_low(me);
-    TM16_DELAY_US(2);
-    clkSet_low(me);
+    for (uint8_t i = 0; i < me->digits; i++) {
+        if (dirty & (1 << i)) {
+            changed++;
+        }
+    }
+
+    if ((changed * 2) < (me->digits + 1)) {
+        script[n++] = 1;
+        script[n++] = TM1637_DATA_CMD_SETTING |
+                        DATA_RW_MODE_WRITE |
+                        TM1637_ADDR_ADD_MODE_FIXED |
+                        me->dispMode;
+
+        for (uint8_t i = 0; i < me->digits; i++) {
+            if (!(dirty & (1 << i))) {
+                continue;
+            }
+            script[n++] = 2;
+            script[n++] = TM1637_ADDRESS_CMD_SETTING | (TM1637_REG_ADDR_MIN + i);
+            script[n++] = frame[i];
+        }
+    } else {
+        script[n++] = 1;
+        script[n++] = TM1637_DATA_CMD_SETTING |
+                        DATA_RW_MODE_WRITE |
+                        TM1637_ADDR_ADD_MODE_AUTO_INC |
+                        me->dispMode;
+
+        script[n++] = 1 + me->digits;
+        script[n++] = TM1637_ADDRESS_CMD_SETTING | TM1637_REG_ADDR_MIN;
+        for (uint8_t i = 0; i < me->digits; i++) {
+            script[n++] = frame[i];
+        }
+    }
+
+    script[n] = 0;
 }
 
-static void tm1617_stop(tm1637Ctxt_t *me)
+static tm1637_status_t runScript(tm1637Ctxt_t *me, const uint8_t *script)
 {
-    dioSet_output(me);
+    tm1637_status_t status = tm1637_status_ok;
+    uint8_t len;
+
+    while ((len = *script++) != 0) {
+        tm1617_start(me);
+        while (len--) {
+            if (!tm1617_writeByte(me, *script++)) {
+                status = tm1637_status_ackError;
+            }
+        }
+        tm1617_stop(me);
+    }
 
-    clkSet_low(me);
-    dioSet_low(me);
-    TM16_DELAY_US(2);
-    clkSet_high(me);
-    TM16_DELAY_US(2);
-    dioSet_high(me);
-    TM16_DELAY_US(2);
+    return status;
 }
 
-static bool tm1617_writeByte(tm1637Ctxt_t *me, uint8_t data)
+static uint8_t frameDirty(tm1637Ctxt_t *me, const uint8_t *frame)
 {
-    bool ret = true;
+    uint8_t dirty = 0;
 
-    dioSet_output(me);
-    for (uint8_t i = 0; i < 8; i++) {
-        if (data & 0x01) {
-            dioSet_high(me);
-        } else {
-            dioSet_low(me);
+    for (uint8_t i = 0; i < me->digits; i++) {
+        if (!me->frameValid || frame[i] != me->frame[i]) {
+            dirty |= (1 << i);
         }
-        TM16_DELAY_US(5);
-        clkPulse(me);
-        data >>= 1;
     }
 
-    // Wait for ACK
-    dioSet_input(me);
-    TM16_DELAY_US(5);
+    return dirty;
+}
+
+/* Start sending next[] if it differs from the display. Interrupts must be
+off: called from tm1637_print() and from the Timer2 ISR. */
+static void startNext(tm1637Ctxt_t *me)
+{
+    uint8_t dirty;
+
+    me->nextPending = 0;
 
-    if (dioRead(me)) {
-        ret = false; // No ACK received
+    dirty = frameDirty(me, me->next);
+    if (!dirty) {
+        return;
     }
 
-    clkPulse(me);
-    TM16_DELAY_US(5);
+    memcpy(me->inflight, me->next, me->digits);
+    buildScript(me, me->inflight, dirty, me->script);
+
+    me->busy = 1;
+    me->busPos = 0;
+    me->busAckOk = 1;
+    me->busState = TM1637_BUS_START_1;
+
+    TCNT2 = 0;
+    TIFR2 = (1 << OCF2A);
+    TIMSK2 |= (1 << OCIE2A);
+}
+
+/* Blocking write of a frame, only the digits that differ from frame[] */
+static void printSync(tm1637Ctxt_t *me, const uint8_t *frame)
+{
+    uint8_t dirty = frameDirty(me, frame);
 
-    if (!dioRead(me)) {
-        ret = false; // No ACK received
+    if (!dirty) {
+        return;
     }
 
-    dioSet_output(me);
-    return ret;
+    buildScript(me, frame, dirty, me->script);
+    me->status = runScript(me, me->script);
+
+    if (me->status == tm1637_status_ok) {
+        memcpy(me->frame, frame, me->digits);
+        me->frameValid = 1;
+    } else {
+        me->frameValid = 0;
+    }
 }
 
 static uint8_t tm1637_encodeChar(char c)
@@ -158,6 +223,7 @@ static uint8_t tm1637_encodeChar(char c)
         case 'L': case 'l': return 0x38;
         case 'O': case 'o': return 0x5C;
         case 'P': case 'p': return 0x73;
+        case 'R': case 'r': return 0x50;
         case 'S': case 's': return 0x6D;
         case 'T': case 't': return 0x78;
         case 'U': case 'u': return 0x3E;
@@ -174,19 +240,19 @@ static uint8_t tm1637_encodeChar(char c)
 /******************************************************************************/
 void tm1637_initHw(tm1637Ctxt_t *me)
 {
-    // Set CLK and DIO as outputs
-    *(me->clkDDR) |= (1 << me->clkBIT);
-    *(me->dioDDR) |= (1 << me->dioBIT);
+    // Set CLK and DIO as outputs, both low
+    me->pins->initHw();
 
-    // Set CLK and DIO low
-    *(me->clkPORT) &= ~(1 << me->clkBIT);
-    *(me->dioPORT) &= ~(1 << me->dioBIT);
+    me->frameValid = 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
 void tm1637_setBrightness(tm1637Ctxt_t *me, uint8_t brightness)
 {
+    tm1637_waitIdle(me);
+    me->status = tm1637_status_ok;
+
     me->brightness = constrain(brightness, TM1637_BRIGHTNESS_MIN, TM1637_BRIGHTNESS_MAX);
 
     tm1617_start(me);
@@ -200,6 +266,9 @@ void tm1637_setBrightness(tm1637Ctxt_t *me, uint8_t brightness)
 
 void tm1637_dispSwitch(tm1637Ctxt_t *me, uint8_t sw)
 {
+    tm1637_waitIdle(me);
+    me->status = tm1637_status_ok;
+
     tm1617_start(me);
     tm1617_writeByte(me, TM1637_DISPLAY_CTRL_CMD_SETTING |
                             (sw ? TM1637_DISPLAY_SW_ON : TM1637_DISPLAY_SW_OFF) |
@@ -211,6 +280,11 @@ void tm1637_dispSwitch(tm1637Ctxt_t *me, uint8_t sw)
 
 void tm1637_dispMode(tm1637Ctxt_t *me, tm1637_dispMode_t mode)
 {
+    tm1637_waitIdle(me);
+    me->status = tm1637_status_ok;
+
+    me->dispMode = mode;
+
     tm1617_start(me);
     tm1617_writeByte(me, TM1637_DATA_CMD_SETTING |
                             DATA_RW_MODE_WRITE |
@@ -222,22 +296,35 @@ void tm1637_dispMode(tm1637Ctxt_t *me, tm1637_dispMode_t mode)
 
 void tm1637_print(tm1637Ctxt_t *me, const char *str)
 {
-    char paddedStr[TM1637_REGS_COUNT] = {' '};
+    uint8_t frame[TM1637_REGS_COUNT];
+    uint8_t len = strlen(str);
 
-    memcpy((paddedStr + (TM1637_REGS_COUNT - strlen(str))), str, strlen(str));
+    HAL_MARK(HAL_MARK_TM1637_PRINT);
 
-    tm1617_start(me);
-    tm1617_writeByte(me, TM1637_ADDRESS_CMD_SETTING |
-                        DATA_RW_MODE_WRITE |
-                        TM1637_ADDR_ADD_MODE_AUTO_INC |
-                        TM1637_REG_ADDR_MIN);
+    // Right aligned, leading characters are cut if the string is too long
+    for (uint8_t i = 0; i < me->digits; i++) {
+        int8_t pos = (int8_t)(len - me->digits + i);
+        char c = (pos >= 0) ? str[pos] : ' ';
 
-    for (uint8_t i = (TM1637_REGS_COUNT - me->digits); i < TM1637_REGS_COUNT; i++) {
-        uint8_t encodedChar = tm1637_encodeChar(paddedStr[i]);
-        tm1617_writeByte(me, encodedChar);
+        frame[i] = tm1637_encodeChar(c);
     }
 
-    tm1617_stop(me);
+    if (me->asyncEn) {
+        uint8_t old_SREG = SREG;
+
+        cli();
+        memcpy(me->next, frame, me->digits);
+        if (me->busy) {
+            me->nextPending = 1;   // picked up when the running transfer ends
+        } else {
+            startNext(me);
+        }
+        SREG = old_SREG;
+    } else {
+        printSync(me, frame);
+    }
+
+    HAL_MARK(HAL_MARK_TM1637_PRINT | HAL_MARK_END);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -250,3 +337,72 @@ void tm1637_setDispRegAddr(tm1637Ctxt_t *me, uint8_t addr)
     tm1617_writeByte(me, TM1637_ADDRESS_CMD_SETTING | addrConstrained);
     tm1617_stop(me);
 }
+
+////////////////////////////////////////////////////////////////////////////////
+
+void tm1637_asyncInit(tm1637Ctxt_t *me, tm1637_doneCb_t onDone)
+{
+    tm1637_waitIdle(me);
+
+    me->onDone = onDone;
+    me->busState = TM1637_BUS_IDLE;
+    me->nextPending = 0;
+
+    // Timer2 CTC, clk/8, compare interrupt enabled only while sending
+    TIMSK2 &= ~(1 << OCIE2A);
+    TCCR2A = (1 << WGM21);
+    TCCR2B = (1 << CS21);
+    OCR2A = TM1637_TIMER2_OCR;
+
+    me->asyncEn = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void tm1637_tick(tm1637Ctxt_t *me)
+{
+    tm1637_tickService(me, me->pins);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void tm1637_busDone(tm1637Ctxt_t *me)
+{
+    TIMSK2 &= ~(1 << OCIE2A);
+
+    me->busState = TM1637_BUS_IDLE;
+    me->busy = 0;
+
+    if (me->busAckOk) {
+        memcpy(me->frame, me->inflight, me->digits);
+        me->frameValid = 1;
+        me->status = tm1637_status_ok;
+    } else {
+        // Unknown what the chip latched, rewrite everything next time
+        me->frameValid = 0;
+        me->status = tm1637_status_ackError;
+        me->ackErrors++;
+    }
+
+    if (me->onDone) {
+        me->onDone(me, me->status);
+    }
+
+    if (me->nextPending) {
+        startNext(me);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool tm1637_isBusy(tm1637Ctxt_t *me)
+{
+    return me->busy || me->nextPending;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+tm1637_status_t tm1637_getStatus(tm1637Ctxt_t *me)
+{
+    return me->status;
+}
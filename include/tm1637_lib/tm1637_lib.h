@@ -5,8 +5,9 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
-#include <avr/io.h>
-#include <util/delay.h>
+#include "hal_lib.h"
+
+#include "gpio_lib.h"
 
 #define TM1637_BRIGHTNESS_MIN 0x00
 #define TM1637_BRIGHTNESS_MAX 0x07
@@ -15,43 +16,177 @@
 #define TM1637_REG_ADDR_MAX 0x05
 #define TM1637_REGS_COUNT   (TM1637_REG_ADDR_MAX + 1)
 
+/* Asynchronous bus engine: Timer2 compare period, one bus edge per tick */
+#define TM1637_TICK_US      20
+#define TM1637_TIMER2_OCR   ((F_CPU / 8 / 1000000UL) * TM1637_TICK_US - 1)
+
+/* Room for the bus transactions of one frame update, see buildScript() */
+#define TM1637_SCRIPT_SIZE  16
+
+/* States of the asynchronous bus engine, one pin edge each */
+enum {
+    TM1637_BUS_IDLE = 0,
+    TM1637_BUS_START_1,     // DIO high, CLK high
+    TM1637_BUS_START_2,     // DIO low
+    TM1637_BUS_START_3,     // CLK low
+    TM1637_BUS_BIT_DATA,    // DIO = next bit
+    TM1637_BUS_BIT_CLK_H,
+    TM1637_BUS_BIT_CLK_L,
+    TM1637_BUS_ACK_IN,      // release DIO
+    TM1637_BUS_ACK_CLK_H,   // sample ACK, CLK high
+    TM1637_BUS_ACK_CLK_L,
+    TM1637_BUS_STOP_1,      // DIO low
+    TM1637_BUS_STOP_2,      // CLK high
+    TM1637_BUS_STOP_3       // DIO high
+};
+
 typedef enum {
     tm1637_dispMode_normal = 0x00,
     tm1637_dispMode_test = 0x08
 } tm1637_dispMode_t;
 
+typedef enum {
+    tm1637_status_ok = 0,
+    tm1637_status_ackError      // chip did not acknowledge a byte
+} tm1637_status_t;
+
+/* Pin access generated per context by TM16_DECLARE_CTXT. Single-edge
+primitives are used for start/stop; writeByte clocks out one byte LSB first
+and checks the ACK with all pin accesses resolved at compile time. */
 typedef struct {
-    volatile uint8_t *clkDDR;
-    volatile uint8_t *clkPORT;
-    uint8_t clkBIT;
+    void (*initHw)(void);
+    void (*clkSet)(uint8_t high);
+    void (*dioSet)(uint8_t high);
+    void (*dioSetOutput)(uint8_t output);
+    uint8_t (*dioRead)(void);
+    bool (*writeByte)(uint8_t data);
+} tm1637Pins_t;
+
+struct tm1637Ctxt;
 
-    volatile uint8_t *dioDDR;
-    volatile uint8_t *dioPORT;
-    volatile uint8_t *dioPIN;
-    uint8_t dioBIT;
+typedef void (*tm1637_doneCb_t)(struct tm1637Ctxt *me, tm1637_status_t status);
+
+typedef struct tm1637Ctxt {
+    const tm1637Pins_t *pins;
 
     uint8_t brightness;
     tm1637_dispMode_t dispMode;
     const uint8_t digits;
+
+    /* Shadow of the segment data last written to the grid registers, a print
+    only sends the digits that differ from it */
+    uint8_t frame[TM1637_REGS_COUNT];
+    uint8_t frameValid;
+
+    /* Result of the last transfer, sync or async */
+    volatile tm1637_status_t status;
+    uint16_t ackErrors;
+
+    /* Asynchronous bus engine (see tm1637_asyncInit). tm1637_print() stores
+    the requested frame in next[]; the Timer2 ISR sends it via script[] and
+    moves it to frame[] once all bytes were acknowledged. */
+    uint8_t asyncEn;
+    tm1637_doneCb_t onDone;
+    uint8_t next[TM1637_REGS_COUNT];
+    volatile uint8_t nextPending;
+    uint8_t inflight[TM1637_REGS_COUNT];
+    uint8_t script[TM1637_SCRIPT_SIZE];
+    volatile uint8_t busy;
+    uint8_t busState;
+    uint8_t busPos;       // next byte in script[]
+    uint8_t busSegLeft;   // bytes left in the current transaction
+    uint8_t busBit;
+    uint8_t busByte;
+    uint8_t busAckOk;
 } tm1637Ctxt_t;
 
+#define TM16_DELAY_US(us) _delay_us(us) // Placeholder for delay function
+
+#define TM16_DECLARE_PINS(name, clkPort, clkBit, dioPort, dioBit) \
+    GPIO_DECLARE_PIN(name##_clk, clkPort, clkBit) \
+    GPIO_DECLARE_PIN(name##_dio, dioPort, dioBit) \
+    static inline void name##_initHw(void) \
+    { \
+        name##_clk_setOutput(); \
+        name##_dio_setOutput(); \
+        name##_clk_setLow(); \
+        name##_dio_setLow(); \
+    } \
+    static inline __attribute__((always_inline)) void name##_clkSet(uint8_t high) \
+    { \
+        if (high) { name##_clk_setHigh(); } else { name##_clk_setLow(); } \
+    } \
+    static inline __attribute__((always_inline)) void name##_dioSet(uint8_t high) \
+    { \
+        if (high) { name##_dio_setHigh(); } else { name##_dio_setLow(); } \
+    } \
+    static inline __attribute__((always_inline)) void name##_dioSetOutput(uint8_t output) \
+    { \
+        if (output) { name##_dio_setOutput(); } else { name##_dio_setInput(); } \
+    } \
+    static inline __attribute__((always_inline)) uint8_t name##_dioRead(void) \
+    { \
+        return name##_dio_read(); \
+    } \
+    static inline bool name##_writeByte(uint8_t data) \
+    { \
+        bool ret = true; \
+        name##_dio_setOutput(); \
+        for (uint8_t i = 0; i < 8; i++) { \
+            if (data & 0x01) { name##_dio_setHigh(); } else { name##_dio_setLow(); } \
+            TM16_DELAY_US(5); \
+            name##_clk_setHigh(); \
+            TM16_DELAY_US(5); \
+            name##_clk_setLow(); \
+            TM16_DELAY_US(5); \
+            data >>= 1; \
+        } \
+        /* Wait for ACK */ \
+        name##_dio_setInput(); \
+        TM16_DELAY_US(5); \
+        if (name##_dio_read()) { ret = false; /* No ACK received */ } \
+        name##_clk_setHigh(); \
+        TM16_DELAY_US(5); \
+        name##_clk_setLow(); \
+        TM16_DELAY_US(5); \
+        TM16_DELAY_US(5); \
+        if (!name##_dio_read()) { ret = false; /* No ACK received */ } \
+        name##_dio_setOutput(); \
+        return ret; \
+    } \
+    static const tm1637Pins_t name##_pins = { \
+        .initHw = name##_initHw, \
+        .clkSet = name##_clkSet, \
+        .dioSet = name##_dioSet, \
+        .dioSetOutput = name##_dioSetOutput, \
+        .dioRead = name##_dioRead, \
+        .writeByte = name##_writeByte \
+    };
+
+/* name_tick(): tm1637_tick() of this context with its pin table known at
+compile time, the pin edges are inlined instead of called through the table.
+Route TIMER2_COMPA_vect to it. */
+#define TM16_DECLARE_TICK(name) \
+    static inline void name##_tick(void) \
+    { \
+        tm1637_tickService(&name, &name##_pins); \
+    }
+
 #define TM16_DECLARE_CTXT(name, clkPort, clkBit, dioPort, dioBit, digitNum) \
+    TM16_DECLARE_PINS(name, clkPort, clkBit, dioPort, dioBit) \
     tm1637Ctxt_t name = { \
-        /* DDR register is PORT - 1 */ \
-        /* PIN register is PORT - 2 */ \
-        .clkPORT = &(clkPort), \
-        .clkDDR = &(clkPort) - 1, \
-        .clkBIT = (clkBit), \
-        .dioPORT = &(dioPort), \
-        .dioDDR = &(dioPort) - 1, \
-        .dioPIN = &(dioPort) - 2, \
-        .dioBIT = (dioBit), \
+        .pins = &name##_pins, \
         .brightness = TM1637_BRIGHTNESS_MAX, \
         .dispMode = tm1637_dispMode_normal, \
-        .digits = (digitNum) \
-    };
-
-#define TM16_DELAY_US(us) _delay_us(us) // Placeholder for delay function
+        .digits = (digitNum), \
+        .frameValid = 0, \
+        .status = tm1637_status_ok, \
+        .ackErrors = 0, \
+        .asyncEn = 0, \
+        .nextPending = 0, \
+        .busy = 0 \
+    }; \
+    TM16_DECLARE_TICK(name)
 
 /**
  * @fn tm1637_initHw
@@ -96,10 +231,153 @@ void tm1637_dispSwitch(tm1637Ctxt_t *me, uint8_t sw);
  * @fn tm1637_print
  * @param me - Pointer to the TM1637 context structure.
  * @param str - String to display (up to 4 characters).
- * @brief Write a string to the TM1637 display.
+ * @brief Write a string to the TM1637 display. Nothing is sent if the
+ *        display already shows it; otherwise only the changed digits are
+ *        written (fixed address mode) when that is cheaper than a full
+ *        auto-increment write.
  */
 void tm1637_print(tm1637Ctxt_t *me, const char *str);
 
+/**
+ * @fn tm1637_asyncInit
+ * @param me - Pointer to the TM1637 context structure.
+ * @param onDone - Called from the ISR after each frame transfer, may be NULL.
+ * @brief Switch tm1637_print() to the asynchronous bus engine driven by the
+ *        Timer2 compare match. The application must route TIMER2_COMPA_vect
+ *        to name_tick() (or tm1637_tick()). Other commands stay synchronous
+ *        and wait for a running transfer first.
+ */
+void tm1637_asyncInit(tm1637Ctxt_t *me, tm1637_doneCb_t onDone);
+
+/**
+ * @fn tm1637_tick
+ * @param me - Pointer to the TM1637 context structure.
+ * @brief Timer ISR body: advance the bus state machine by one edge. Pin
+ *        access goes through me->pins; the name_tick() generated by
+ *        TM16_DECLARE_CTXT avoids that.
+ */
+void tm1637_tick(tm1637Ctxt_t *me);
+
+/**
+ * @fn tm1637_busDone
+ * @param me - Pointer to the TM1637 context structure.
+ * @brief Part of tm1637_tickService(): end a frame transfer, report it and
+ *        start the next queued frame.
+ */
+void tm1637_busDone(tm1637Ctxt_t *me);
+
+/**
+ * @fn tm1637_tickService
+ * @param me   - Pointer to the TM1637 context structure.
+ * @param pins - Its pin table.
+ * @brief Body of tm1637_tick(). Inlined with a constant pin table, each
+ *        state is a few pin instructions; the only call left is
+ *        tm1637_busDone() at the end of a frame.
+ */
+static inline __attribute__((always_inline))
+void tm1637_tickService(tm1637Ctxt_t *me, const tm1637Pins_t *pins)
+{
+    switch (me->busState) {
+        case TM1637_BUS_START_1:
+            pins->dioSetOutput(1);
+            pins->dioSet(1);
+            pins->clkSet(1);
+            me->busSegLeft = me->script[me->busPos++];
+            me->busState = TM1637_BUS_START_2;
+            break;
+
+        case TM1637_BUS_START_2:
+            pins->dioSet(0);
+            me->busState = TM1637_BUS_START_3;
+            break;
+
+        case TM1637_BUS_START_3:
+            pins->clkSet(0);
+            me->busByte = me->script[me->busPos++];
+            me->busBit = 0;
+            me->busState = TM1637_BUS_BIT_DATA;
+            break;
+
+        case TM1637_BUS_BIT_DATA:
+            pins->dioSet(me->busByte & 0x01);
+            me->busByte >>= 1;
+            me->busState = TM1637_BUS_BIT_CLK_H;
+            break;
+
+        case TM1637_BUS_BIT_CLK_H:
+            pins->clkSet(1);
+            me->busState = TM1637_BUS_BIT_CLK_L;
+            break;
+
+        case TM1637_BUS_BIT_CLK_L:
+            pins->clkSet(0);
+            me->busState = (++me->busBit < 8) ? TM1637_BUS_BIT_DATA : TM1637_BUS_ACK_IN;
+            break;
+
+        case TM1637_BUS_ACK_IN:
+            pins->dioSetOutput(0);
+            me->busState = TM1637_BUS_ACK_CLK_H;
+            break;
+
+        case TM1637_BUS_ACK_CLK_H:
+            if (pins->dioRead()) {
+                me->busAckOk = 0; // No ACK received
+            }
+            pins->clkSet(1);
+            me->busState = TM1637_BUS_ACK_CLK_L;
+            break;
+
+        case TM1637_BUS_ACK_CLK_L:
+            pins->clkSet(0);
+            pins->dioSetOutput(1);
+            if (--me->busSegLeft) {
+                me->busByte = me->script[me->busPos++];
+                me->busBit = 0;
+                me->busState = TM1637_BUS_BIT_DATA;
+            } else {
+                me->busState = TM1637_BUS_STOP_1;
+            }
+            break;
+
+        case TM1637_BUS_STOP_1:
+            pins->dioSet(0);
+            me->busState = TM1637_BUS_STOP_2;
+            break;
+
+        case TM1637_BUS_STOP_2:
+            pins->clkSet(1);
+            me->busState = TM1637_BUS_STOP_3;
+            break;
+
+        case TM1637_BUS_STOP_3:
+            pins->dioSet(1);
+            if (me->script[me->busPos]) {
+                me->busState = TM1637_BUS_START_1;
+            } else {
+                tm1637_busDone(me);
+            }
+            break;
+
+        default:
+            TIMSK2 &= ~(1 << OCIE2A);
+            break;
+    }
+}
+
+/**
+ * @fn tm1637_isBusy
+ * @param me - Pointer to the TM1637 context structure.
+ * @return true while an asynchronous transfer is running or queued.
+ */
+bool tm1637_isBusy(tm1637Ctxt_t *me);
+
+/**
+ * @fn tm1637_getStatus
+ * @param me - Pointer to the TM1637 context structure.
+ * @return Status of the last completed transfer.
+ */
+tm1637_status_t tm1637_getStatus(tm1637Ctxt_t *me);
+
 void tm1637_test(tm1637Ctxt_t *me);
 
 /* _TM1637_LIB_H_ */
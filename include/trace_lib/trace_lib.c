@@ -0,0 +1,129 @@
+#include "trace_lib.h"
+
+#include <string.h>
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+static uint8_t *putVarint(uint8_t *p, uint32_t v)
+{
+    while (v >= 0x80) {
+        *p++ = (uint8_t)v | 0x80;
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+
+    return p;
+}
+
+static bool getVarint(traceReader_t *me, uint32_t *v)
+{
+    uint32_t out = 0;
+
+    for (uint8_t shift = 0; shift < 35; shift += 7) {
+        uint8_t b;
+
+        if (me->pos >= me->end) {
+            return false;
+        }
+        b = *me->pos++;
+        out |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = out;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* Small deltas of either sign become small unsigned values */
+static uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/******************************************************************************/
+/*                         Public function definitions                        */
+/******************************************************************************/
+void trace_reset(traceCtxt_t *me)
+{
+    memset(&me->st, 0, sizeof(me->st));
+    me->block[0] = 0;
+    me->len = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool trace_add(traceCtxt_t *me, uint32_t timestamp, int32_t raw, uint8_t tag)
+{
+    uint8_t *p = &me->block[me->len];
+
+    tag &= TRACE_TAG_MASK;
+
+    if ((me->len + TRACE_RECORD_MAX > TRACE_BLOCK_MAX) || (me->block[0] == UINT8_MAX)) {
+        return false;
+    }
+
+    *p++ = tag;
+    p = putVarint(p, timestamp - me->st.lastTs);
+    p = putVarint(p, zigzag((int32_t)((uint32_t)raw - (uint32_t)me->st.lastRaw[tag])));
+
+    me->st.lastTs = timestamp;
+    me->st.lastRaw[tag] = raw;
+    me->len = (uint8_t)(p - me->block);
+    me->block[0]++;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint8_t trace_count(const traceCtxt_t *me)
+{
+    return me->block[0];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void trace_open(traceReader_t *me, const uint8_t *block, uint8_t len)
+{
+    memset(&me->st, 0, sizeof(me->st));
+    me->pos = block;
+    me->end = block + len;
+    me->left = len ? *me->pos++ : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool trace_next(traceReader_t *me, traceRecord_t *rec)
+{
+    uint32_t dt;
+    uint32_t dv;
+    uint8_t tag;
+
+    if (!me->left || (me->pos >= me->end)) {
+        return false;
+    }
+
+    tag = *me->pos++;
+    if ((tag & ~TRACE_TAG_MASK) || !getVarint(me, &dt) || !getVarint(me, &dv)) {
+        me->left = 0;
+        return false;
+    }
+
+    me->st.lastTs += dt;
+    me->st.lastRaw[tag] = (int32_t)((uint32_t)me->st.lastRaw[tag] + (uint32_t)unzigzag(dv));
+    me->left--;
+
+    rec->timestamp = me->st.lastTs;
+    rec->raw = me->st.lastRaw[tag];
+    rec->tag = tag;
+
+    return true;
+}
@@ -0,0 +1,105 @@
+#ifndef _TRACE_LIB_H_
+#define _TRACE_LIB_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/*
+ * Compact trace of raw HX711 conversions for offline replay.
+ *
+ * A block holds a record count followed by the records:
+ *   [0]    number of records N
+ *   N x    tag u8   bits 0..1 input select (xh17_inputSelect_t), rest 0
+ *          dt       varint, microseconds since the previous record
+ *          dv       zigzag varint, raw minus the previous raw of the same
+ *                   input select
+ *
+ * Varints are LEB128 (7 bits per byte, LSB first, bit 7 = more). Delta state
+ * starts from zero in every block, so the first record carries the absolute
+ * timestamp and raw values and a lost block doesn't break the next one. A
+ * settled 10 SPS signal takes about 6 bytes per sample (3 byte dt, 2 byte dv)
+ * against 8 for plain timestamp, raw and tag.
+ *
+ * Blocks travel as TLM_TYPE_TRACE telemetry payloads; host tools store them
+ * as [length u8][block] after the TRACE_FILE_MAGIC header.
+ */
+#define TRACE_BLOCK_MAX     60
+#define TRACE_RECORD_MAX    11      // tag + 5 byte dt + 5 byte dv
+
+#define TRACE_TAGS          4
+#define TRACE_TAG_MASK      (TRACE_TAGS - 1)
+
+#define TRACE_FILE_MAGIC    "HXTR\x01"
+#define TRACE_FILE_MAGIC_LEN 5
+
+typedef struct {
+    uint32_t timestamp;     // micros()
+    int32_t raw;
+    uint8_t tag;
+} traceRecord_t;
+
+/* Delta state shared by the encoder and the decoder */
+typedef struct {
+    uint32_t lastTs;
+    int32_t lastRaw[TRACE_TAGS];
+} traceState_t;
+
+typedef struct {
+    traceState_t st;
+    uint8_t len;                    // bytes used in block[]
+    uint8_t block[TRACE_BLOCK_MAX];
+} traceCtxt_t;
+
+typedef struct {
+    traceState_t st;
+    const uint8_t *pos;
+    const uint8_t *end;
+    uint8_t left;                   // records not yet returned
+} traceReader_t;
+
+/**
+ * @fn trace_reset
+ * @param me - Pointer to the trace encoder.
+ * @brief Start a new, empty block.
+ */
+void trace_reset(traceCtxt_t *me);
+
+/**
+ * @fn trace_add
+ * @param me        - Pointer to the trace encoder.
+ * @param timestamp - Sample time, microseconds.
+ * @param raw       - Raw conversion as read from the HX711.
+ * @param tag       - Input select of the conversion, 0..TRACE_TAGS-1.
+ * @brief Append a record to the block.
+ * @return false if the block is full; send it, call trace_reset() and add
+ *         the record again.
+ */
+bool trace_add(traceCtxt_t *me, uint32_t timestamp, int32_t raw, uint8_t tag);
+
+/**
+ * @fn trace_count
+ * @param me - Pointer to the trace encoder.
+ * @return Number of records in the block.
+ */
+uint8_t trace_count(const traceCtxt_t *me);
+
+/**
+ * @fn trace_open
+ * @param me    - Pointer to the reader.
+ * @param block - Block bytes, as built by trace_add().
+ * @param len   - Block length.
+ * @brief Prepare to read the records of one block.
+ */
+void trace_open(traceReader_t *me, const uint8_t *block, uint8_t len);
+
+/**
+ * @fn trace_next
+ * @param me  - Pointer to the reader.
+ * @param rec - Next record.
+ * @return false at the end of the block or on a malformed record.
+ */
+bool trace_next(traceReader_t *me, traceRecord_t *rec);
+
+/* _TRACE_LIB_H_ */
+#endif
@@ -6,6 +6,12 @@ enum USART0_STATUS USART0_Status = READY_FOR_NEW_DATA;
 
 volatile uint8_t counter = 0;
 
+static volatile uint8_t USART0_txBuf[USART0_TX_BUFFER_SIZE];
+static volatile uint8_t txHead = 0;	// written by producer only
+static volatile uint8_t txTail = 0;	// written by USART_UDRE_vect only
+static volatile uint16_t txDropped = 0;
+static volatile uint8_t txPending = 0;	// set on enqueue, cleared when TXC0 seen
+
 
 #ifdef USART0_START_SYMDOL
 	uint8_t ReceiveEnable = 0;
@@ -35,7 +41,8 @@ ISR(USART_RX_vect)
 
 	if(ReceiveEnable == 1){	
 
-		if(tmp == USART0_STOP_SYMBOL || !(counter < USART0_BUFFER_SIZE)){
+		// Keep the last byte for the terminator
+		if(tmp == USART0_STOP_SYMBOL || !(counter < USART0_BUFFER_SIZE - 1)){
 			USART0_buf[counter] = '\0';
 			ReceiveEnable = 0;
 			counter = 0;
@@ -59,6 +66,42 @@ ISR(USART_RX_vect)
 //-----------------------------------------------------------------------------
 
 
+ISR(USART_UDRE_vect)
+{
+	uint8_t tail = txTail;
+
+	if(tail == txHead){
+		UCSR0B &= ~(1<<UDRIE0);
+		return;
+	}
+
+	UCSR0A |= (1<<TXC0);
+	UDR0 = USART0_txBuf[tail & (USART0_TX_BUFFER_SIZE - 1)];
+	txTail = tail + 1;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+static void USART0_TxPoll()
+{
+	// Used when interrupts are off and the queue still has to move
+	uint8_t tail = txTail;
+
+	if(tail == txHead)
+		return;
+
+	while ( !( UCSR0A & (1<<UDRE0)) );
+	UCSR0A |= (1<<TXC0);
+	UDR0 = USART0_txBuf[tail & (USART0_TX_BUFFER_SIZE - 1)];
+	txTail = tail + 1;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
 void USART0_init()
 {
 	uint32_t USARTSpeed;
@@ -140,8 +183,90 @@ void USART0_init()
 
 void USART0_SendChar(char data)
 {
-	while ( !( UCSR0A & (1<<UDRE0)) );
-	UDR0 = data;
+	// Wait for room first, a byte that is sent late is not a dropped one
+	while(!USART0_TxFree()){
+		if(!(SREG & (1<<SREG_I)))
+			USART0_TxPoll();
+	}
+
+	USART0_Write(&data, 1);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+uint8_t USART0_Write(const void * data, uint8_t len)
+{
+	const uint8_t * src = (const uint8_t *)data;
+	uint8_t head = txHead;
+	uint8_t room = USART0_TX_BUFFER_SIZE - (uint8_t)(head - txTail);
+	uint8_t n = (len < room) ? len : room;
+	uint8_t idx = head & (USART0_TX_BUFFER_SIZE - 1);
+	uint8_t first = USART0_TX_BUFFER_SIZE - idx;
+
+	if(first > n)
+		first = n;
+
+	memcpy((uint8_t *)&USART0_txBuf[idx], src, first);
+	memcpy((uint8_t *)&USART0_txBuf[0], src + first, n - first);
+
+	if(n < len){
+		uint16_t d = txDropped + (len - n);
+		txDropped = (d < txDropped) ? 0xFFFF : d;
+	}
+
+	if(n){
+		// Data must be in the queue before the ISR can see the new head
+		__asm__ __volatile__ ("" ::: "memory");
+		txHead = head + n;
+		txPending = 1;
+		UCSR0B |= (1<<UDRIE0);
+	}
+
+	return n;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+uint8_t USART0_TxFree()
+{
+	return USART0_TX_BUFFER_SIZE - (uint8_t)(txHead - txTail);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+uint16_t USART0_GetDropCount()
+{
+	uint16_t d;
+	uint8_t old_SREG = SREG;
+
+	cli();
+	d = txDropped;
+	SREG = old_SREG;
+
+	return d;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void USART0_Flush()
+{
+	while(txTail != txHead){
+		if(!(SREG & (1<<SREG_I)))
+			USART0_TxPoll();
+	}
+
+	if(txPending){
+		while ( !( UCSR0A & (1<<TXC0)) );
+		txPending = 0;
+	}
 }
 
 
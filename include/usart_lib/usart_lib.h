@@ -5,12 +5,11 @@
 #define F_CPU 16000000UL
 #endif
 
-#include <avr/io.h>
+#include "hal_lib.h"
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
+#include <string.h>
 
 //-----------------------------------------------------------------------------
 //#############################################################################
@@ -43,7 +42,7 @@
 // Enabling/disabling of receiving data
 // 1 -> receiving data is enable
 // 0 -> receiving data is disable
-#define USART0_RX_EN 0
+#define USART0_RX_EN 1
 
 // Enabling/disabling of transmitting data
 // 1 -> transmitting data is enable
@@ -53,7 +52,7 @@
 // Enabling/disabling of interrupt for receiver
 // 1 -> interrupt for receiver is enable
 // 0 -> interrupt for receiver is disable
-#define USART0_RXCI_EN 0
+#define USART0_RXCI_EN 1
 
 
 //#define USART0_START_SYMDOL	'#'
@@ -64,6 +63,9 @@
 
 #define USART0_TIMEOUT 10
 
+//Size of transmit queue drained by USART_UDRE_vect, must be a power of two
+#define USART0_TX_BUFFER_SIZE 128
+
 
 //-----------------------------------------------------------------------------
 //#############################################################################
@@ -102,6 +104,38 @@ void USART0_SendChar(char data);
 void USART0_SendData(char * data);
 
 
+/**
+ * Put data into the transmit queue without waiting. Bytes that don't fit
+ * are dropped and counted, see USART0_GetDropCount(). The blocking senders
+ * (USART0_SendChar() and what is built on it) wait for room instead and
+ * never count a drop
+ * @param data Pointer to first byte to send
+ * @param len Number of bytes to send
+ * @return Number of bytes accepted
+ */
+uint8_t USART0_Write(const void * data, uint8_t len);
+
+
+/**
+ * Free space in the transmit queue
+ * @return Number of bytes USART0_Write() will accept right now
+ */
+uint8_t USART0_TxFree();
+
+
+/**
+ * Number of bytes dropped because the transmit queue was full
+ * @return Drop counter (saturates at 0xFFFF)
+ */
+uint16_t USART0_GetDropCount();
+
+
+/**
+ * Wait until the transmit queue is empty and the last byte left the shifter
+ */
+void USART0_Flush();
+
+
 /**
  * Return status of receiving of data
  * @return [description]
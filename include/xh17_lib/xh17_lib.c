@@ -4,26 +4,151 @@
 /*                        Static function definitions                         */
 /******************************************************************************/
 
-static void pdSckSet_high(xh17Ctxt_t *me)
+GPIO_DECLARE_PIN(spiSck, PORTB, PB5)
+GPIO_DECLARE_PIN(spiMiso, PORTB, PB4)
+GPIO_DECLARE_PIN(spiSs, PORTB, PB2)
+
+static void spiInitHw(void)
 {
-    *me->pdSckPORT |= (1 << me->pdSckBIT);
-    XH17_DELAY_US(1);
+    spiMiso_setInput();
+    spiMiso_setHigh();  // Enable pull-up resistor on DOUT
+    spiSck_setOutput();
+    spiSck_setLow();
+    spiSs_setOutput();  // SS as output, otherwise SPI may drop to slave
+    SPCR = 0;           // Enabled only for the duration of a read
+}
+
+static uint8_t spiIsReady(void)
+{
+    return !spiMiso_read();
 }
 
-static void pdSckSet_low(xh17Ctxt_t *me)
+static void spiPdSckSet(uint8_t high)
 {
-    *me->pdSckPORT &= ~(1 << me->pdSckBIT);
+    if (high) {
+        spiSck_setHigh();
+    } else {
+        spiSck_setLow();
+    }
     XH17_DELAY_US(1);
 }
 
-static uint8_t dOutRead(xh17Ctxt_t *me)
+static uint8_t spiTransfer(void)
+{
+    SPDR = 0x00;
+    while (!(SPSR & (1 << SPIF)));
+    return SPDR;
+}
+
+static void spiPulses(uint8_t n)
+{
+    while (n--) {
+        spiSck_setHigh();
+        XH17_DELAY_US(1);
+        spiSck_setLow();
+        XH17_DELAY_US(1);
+    }
+}
+
+static int32_t spiShiftIn(uint8_t extraPulses)
+{
+    int32_t count;
+    uint8_t old_SREG;
+
+    SPSR = XH17_SPI_SPSR;
+    SPCR = XH17_SPI_SPCR;
+
+    count = (int32_t)spiTransfer() << 16;
+    count |= (int32_t)spiTransfer() << 8;
+    count |= spiTransfer();
+
+    // SCK returns to PORTB control (low) once the SPI is disabled
+    SPCR = 0;
+
+    // Gain select pulses must not be stretched past the power-down window
+    old_SREG = SREG;
+    cli();
+    spiPulses(extraPulses);
+    SREG = old_SREG;
+
+    count ^= 0x800000; // Set the sign bit
+
+    return count;
+}
+
+const xh17Pins_t xh17_spiPins = {
+    .initHw = spiInitHw,
+    .isReady = spiIsReady,
+    .pdSckSet = spiPdSckSet,
+    .shiftIn = spiShiftIn,
+    .pulses = spiPulses,
+    .dOutPORT = &PORTB,
+    .dOutBIT = PB4
+};
+
+static int32_t shiftIn(xh17Ctxt_t *me)
 {
-    return (*me->dOutPIN & (1 << me->dOutBIT)) ? 1 : 0;
+    return me->pins->shiftIn(xh17_gainPulses(me->inputSelect));
 }
 
-static inline uint32_t u32AbsDiff(uint32_t a, uint32_t b)
+static inline uint32_t absSigned(int32_t raw)
 {
-    return (a > b) ? (a - b) : (b - a);
+    int32_t d = raw - 0x800000L; // offset binary -> signed count
+
+    return (d < 0) ? (uint32_t)-d : (uint32_t)d;
+}
+
+/* Pick the input of the conversion after next from the sample just read.
+Only called for samples that are kept, so a switch always sees at least one
+settled conversion of the current input. */
+static xh17_inputSelect_t nextSelect(xh17Ctxt_t *me, uint8_t sel, int32_t raw)
+{
+    if (me->refLeft) {
+        me->refLeft--;
+        return xh17_inputSelect_A_64_ref;
+    }
+
+    if (sel == xh17_inputSelect_B_32) {
+        return me->rangeSel;
+    }
+
+    if (me->autoRange) {
+        if ((sel == xh17_inputSelect_A_128) && (absSigned(raw) > XH17_RANGE_HIGH)) {
+            me->rangeSel = xh17_inputSelect_A_64;
+        } else if ((sel == xh17_inputSelect_A_64) && (absSigned(raw) < XH17_RANGE_LOW)) {
+            me->rangeSel = xh17_inputSelect_A_128;
+        }
+    }
+
+    if (me->scanEvery && (++me->scanCount >= me->scanEvery)) {
+        me->scanCount = 0;
+        return xh17_inputSelect_B_32;
+    }
+
+    return me->rangeSel;
+}
+
+/* Gain 64 -> gain 128 counts: ref128 + d * ratio, d split to stay in 32 bit */
+static int32_t toGain128(xh17Ctxt_t *me, int32_t raw)
+{
+    int32_t d = raw - me->ref64;
+    int32_t r = me->gainRatio_q12;
+
+    return me->ref128 + (d >> 12) * r + (((d & 0xFFF) * r) >> 12);
+}
+
+/* Average the reference conversions of xh17_calibrateRange() */
+static void rangeRefAdd(xh17Ctxt_t *me, int32_t raw)
+{
+    if (me->refCount >= XH17_RANGE_REF_SAMPLES) {
+        return;
+    }
+
+    me->refSum += raw;
+    if (++me->refCount == XH17_RANGE_REF_SAMPLES) {
+        me->ref64 = me->refSum / XH17_RANGE_REF_SAMPLES;
+        me->ref128 = (int32_t)me->offset;
+    }
 }
 
 /******************************************************************************/
@@ -32,17 +157,21 @@ static inline uint32_t u32AbsDiff(uint32_t a, uint32_t b)
 void xh17_setInputSelect(xh17Ctxt_t *me, xh17_inputSelect_t inputSelect)
 {
     me->inputSelect = inputSelect;
+    if (inputSelect != xh17_inputSelect_B_32) {
+        me->rangeSel = inputSelect;
+    }
 
-    pdSckSet_low(me);
+    me->pins->pdSckSet(0);
     (void)xh17_readRaw(me); // Dummy read to apply new input select
 }
 
 void xh17_initHw(xh17Ctxt_t *me)
 {
-    *me->dOutDDR  &= ~(1 << me->dOutBIT); // Set DOUT as input
-    *me->dOutPORT |= (1 << me->dOutBIT);  // Enable pull-up resistor on DOUT
-    *me->pdSckDDR |= (1 << me->pdSckBIT); // Set PD_SCK as output
-    pdSckSet_low(me);
+    me->pins->initHw(); // DOUT input with pull-up, PD_SCK output low
+
+    if (me->rateSet) {
+        me->rateSet(me->rate == xh17_rate_80SPS);
+    }
 
     xh17_setInputSelect(me, me->inputSelect); // Apply initial input select
 }
@@ -51,7 +180,7 @@ void xh17_initHw(xh17Ctxt_t *me)
 
 bool xh17_isReady(xh17Ctxt_t *me)
 {
-    return !dOutRead(me);
+    return me->pins->isReady();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -65,69 +194,251 @@ void xh17_waitUntilReady(xh17Ctxt_t *me)
 
 int32_t xh17_readRaw(xh17Ctxt_t *me)
 {
-    int32_t count = 0;
-    uint8_t i;
-    
+    int32_t count;
+
+    if (me->asyncEn) {
+        while (!xh17_popRaw(me, &count));
+        return count;
+    }
+
     xh17_waitUntilReady(me);
 
-    for (i = 0; i < 24; i++) {
-        pdSckSet_high(me);
-        count = count << 1;
-        pdSckSet_low(me);
-        count |= dOutRead(me) ? 0x01 : 0x00;
+    HAL_MARK(HAL_MARK_XH17_READ);
+    count = shiftIn(me);
+    HAL_MARK(HAL_MARK_XH17_READ | HAL_MARK_END);
+
+    return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void xh17_startAsync(xh17Ctxt_t *me)
+{
+    volatile uint8_t *pcMsk;
+
+    if (me->pins->dOutPORT == &PORTB) {
+        me->pcIdx = 0;
+        pcMsk = &PCMSK0;
+    } else if (me->pins->dOutPORT == &PORTC) {
+        me->pcIdx = 1;
+        pcMsk = &PCMSK1;
+    } else {
+        me->pcIdx = 2;
+        pcMsk = &PCMSK2;
     }
 
-    if (me->inputSelect == xh17_inputSelect_B_32) {
-        pdSckSet_high(me);
-        pdSckSet_low(me);
+    me->ringHead = 0;
+    me->ringTail = 0;
+    me->ringDropped = 0;
+    me->convSel = me->inputSelect;
+    me->discard = 0;
+    me->asyncEn = 1;
+
+    *pcMsk |= (1 << me->pins->dOutBIT);
+    PCIFR = (1 << me->pcIdx);
+    PCICR |= (1 << me->pcIdx);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void xh17_stopAsync(xh17Ctxt_t *me)
+{
+    volatile uint8_t *pcMsk = (me->pcIdx == 0) ? &PCMSK0 :
+                              (me->pcIdx == 1) ? &PCMSK1 : &PCMSK2;
+
+    *pcMsk &= ~(1 << me->pins->dOutBIT);
+    if (*pcMsk == 0) {
+        PCICR &= ~(1 << me->pcIdx);
     }
 
-    if (me->inputSelect == xh17_inputSelect_A_64) {
-        pdSckSet_high(me);
-        pdSckSet_low(me);
+    me->asyncEn = 0;
+    me->ringTail = me->ringHead;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void xh17_irqHandler(xh17Ctxt_t *me)
+{
+    xh17_irqService(me, me->pins);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool xh17_irqSelect(xh17Ctxt_t *me, uint8_t sel, int32_t count)
+{
+    if (me->discard) {
+        me->discard--;
+        me->convDiscarded++;
+        return false;
     }
 
-    count ^= 0x800000; // Set the sign bit
+    xh17_inputSelect_t next = nextSelect(me, sel, count);
 
-    return count;
+    if (next != me->inputSelect) {
+        me->inputSelect = next;
+        me->discard = XH17_SWITCH_DISCARD;
+    }
+
+    return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-int32_t xh17_readFiltered(xh17Ctxt_t *me)
+void xh17_irqPush(xh17Ctxt_t *me, uint8_t sel, int32_t count, uint32_t ticks)
 {
-    int32_t x = xh17_readRaw(me);
+    uint8_t head = me->ringHead;
 
-    if (!me->filtInited) {
-        me->count = x;
-        me->countOut = x;
-        me->filtInited = 1;
-    } else {
-        // ---- ADAPTIVE ALPHA ----
-        int32_t d = u32AbsDiff(x, me->count);
-        uint8_t alpha_q8;
-
-        if (d <= me->dLow) {
-            alpha_q8 = me->alphaMin_q8;
-        } else if (d >= me->dHigh) {
-            alpha_q8 = me->alphaMax_q8;
-        } else {
-            uint32_t num = (d - me->dLow) * (uint32_t)(me->alphaMax_q8 - me->alphaMin_q8);
-            uint32_t den = (me->dHigh - me->dLow);
-            alpha_q8 = (uint8_t)(me->alphaMin_q8 + (num / den));
+    if ((uint8_t)(head - me->ringTail) >= XH17_RING_SIZE) {
+        if (me->ringDropped < UINT8_MAX) {
+            me->ringDropped++;
         }
+        return;
+    }
+
+    me->ring[head & (XH17_RING_SIZE - 1)].raw = count;
+    me->ring[head & (XH17_RING_SIZE - 1)].sel = sel;
+    me->ring[head & (XH17_RING_SIZE - 1)].ticks = ticks;
+    me->ringHead = head + 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint8_t xh17_available(xh17Ctxt_t *me)
+{
+    return (uint8_t)(me->ringHead - me->ringTail);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool xh17_popSample(xh17Ctxt_t *me, xh17Sample_t *s)
+{
+    uint8_t tail = me->ringTail;
+
+    if (tail == me->ringHead) {
+        return false;
+    }
+
+    s->raw = me->ring[tail & (XH17_RING_SIZE - 1)].raw;
+    s->sel = me->ring[tail & (XH17_RING_SIZE - 1)].sel;
+    s->ticks = me->ring[tail & (XH17_RING_SIZE - 1)].ticks;
+    me->ringTail = tail + 1;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool xh17_sampleToRaw(xh17Ctxt_t *me, const xh17Sample_t *s, int32_t *raw)
+{
+    if (s->sel == xh17_inputSelect_B_32) {
+        me->lastB = s->raw;
+        me->lastBValid = 1;
+        return false;
+    }
+
+    if (s->sel == xh17_inputSelect_A_64_ref) {
+        rangeRefAdd(me, s->raw);
+        return false;
+    }
+
+    if (me->autoRange && (s->sel == xh17_inputSelect_A_64)) {
+        *raw = toGain128(me, s->raw);
+    } else {
+        *raw = s->raw;
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
 
-        // ---- EMA UPDATE (internal) ----
-        int32_t diff = (int32_t)x - (int32_t)me->count;
-        me->count = (int32_t)me->count + (int32_t)(((int64_t)diff * alpha_q8) >> 8);
+bool xh17_popRaw(xh17Ctxt_t *me, int32_t *raw)
+{
+    xh17Sample_t s;
 
-        // ---- DEAD-BAND FOR OUTPUT ----
-        if (u32AbsDiff(me->count, me->countOut) > me->outDeadBand) {
-            me->countOut = me->count; // update output only if significant change
+    while (xh17_popSample(me, &s)) {
+        if (xh17_sampleToRaw(me, &s, raw)) {
+            return true;
         }
     }
 
-    return me->countOut;
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool xh17_getChannelB(xh17Ctxt_t *me, int32_t *raw)
+{
+    bool fresh = me->lastBValid;
+
+    *raw = me->lastB;
+    me->lastBValid = 0;
+
+    return fresh;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void xh17_setAutoRange(xh17Ctxt_t *me, uint8_t enable)
+{
+    me->autoRange = enable;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void xh17_setGainRatio(xh17Ctxt_t *me, uint16_t ratio_q12)
+{
+    me->gainRatio_q12 = ratio_q12;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void xh17_calibrateRange(xh17Ctxt_t *me)
+{
+    if (!me->asyncEn || !me->autoRange) {
+        return;
+    }
+
+    me->refSum = 0;
+    me->refCount = 0;
+    me->refLeft = XH17_RANGE_REF_SAMPLES;   // last: the ISR starts on it
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void xh17_setScan(xh17Ctxt_t *me, uint8_t every)
+{
+    me->scanCount = 0;
+    me->scanEvery = every;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint16_t xh17_sampleRate_cHz(xh17Ctxt_t *me)
+{
+    uint16_t rate = (me->rate == xh17_rate_80SPS) ? 8000 : 1000;
+
+    if (!me->scanEvery) {
+        return rate;
+    }
+
+    // Per scan cycle: scanEvery A samples + one B sample + the discards
+    return (uint32_t)rate * me->scanEvery /
+           (me->scanEvery + 1 + 2 * XH17_SWITCH_DISCARD);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int32_t xh17_readFiltered(xh17Ctxt_t *me)
+{
+    return xh17_filter(me, xh17_readRaw(me));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int32_t xh17_filter(xh17Ctxt_t *me, int32_t x)
+{
+    return filter_process(&me->filt, x);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -136,11 +447,9 @@ void xh17_setFilterParams(xh17Ctxt_t *me, int32_t dLow, int32_t dHigh,
                             uint8_t alphaMin_q8, uint8_t alphaMax_q8,
                             int32_t outDeadBand)
 {
-    me->dLow = dLow;
-    me->dHigh = dHigh;
-    me->alphaMin_q8 = alphaMin_q8;
-    me->alphaMax_q8 = alphaMax_q8;
-    me->outDeadBand = outDeadBand;
+    filter_init(&me->filt);
+    filter_addAdaptiveEma(&me->filt, dLow, dHigh, alphaMin_q8, alphaMax_q8);
+    filter_addDeadBand(&me->filt, outDeadBand);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -159,6 +468,16 @@ int32_t xh17_readRawAvg(xh17Ctxt_t *me, uint8_t samples)
 void xh17_setScale(xh17Ctxt_t *me, uint32_t scale)
 {
     me->scale = scale;
+    calib_setSpan(&me->cal, (int32_t)scale, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void xh17_setSpan(xh17Ctxt_t *me, int32_t spanCounts, int32_t spanUnits)
+{
+    if (calib_setSpan(&me->cal, spanCounts, spanUnits) && spanUnits) {
+        me->scale = (uint32_t)labs(spanCounts / spanUnits);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -166,6 +485,7 @@ void xh17_setScale(xh17Ctxt_t *me, uint32_t scale)
 void xh17_setOffset(xh17Ctxt_t *me, uint32_t offset)
 {
     me->offset = offset;
+    me->aztDrift = 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -177,28 +497,229 @@ void xh17_tare(xh17Ctxt_t *me)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void xh17_setZeroTracking(xh17Ctxt_t *me, int32_t band, uint16_t step)
+{
+    me->aztBand = band;
+    me->aztStep = step;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void xh17_zeroTrack(xh17Ctxt_t *me, int32_t filtered, bool stable)
+{
+    int32_t d = filtered - (int32_t)me->offset;
+
+    if (!stable || (me->aztBand <= 0) || (labs(d) > me->aztBand)) {
+        return;
+    }
+
+    // Rate limit: move by at most aztStep per sample
+    if (d > (int32_t)me->aztStep) {
+        d = me->aztStep;
+    } else if (d < -(int32_t)me->aztStep) {
+        d = -(int32_t)me->aztStep;
+    }
+
+    me->offset += d;
+    me->aztDrift += d;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int32_t xh17_getDrift(xh17Ctxt_t *me)
+{
+    return me->aztDrift;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool xh17_setRate(xh17Ctxt_t *me, xh17_rate_t rate)
+{
+    if (!me->rateSet) {
+        return false;
+    }
+
+    if (rate == me->rate) {
+        return true;
+    }
+
+    me->rateSet(rate == xh17_rate_80SPS);
+    me->rate = rate;
+    filter_setRate(&me->filt, (rate == xh17_rate_80SPS) ? XH17_RATE_SHIFT_80SPS : 0);
+
+    if (me->asyncEn) {
+        me->discard = XH17_RATE_DISCARD;
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 void xh17_setMode(xh17Ctxt_t *me, xh17_mode_t mode)
 {
     if (mode == xh17_mode_PowerDown) {
         // Enter power-down mode
-        pdSckSet_high(me);
+        me->pins->pdSckSet(1);
         XH17_DELAY_US(65); // Hold PD_SCK high for at least 60us
     } else {
         // Exit power-down mode
-        pdSckSet_low(me);
+        me->pins->pdSckSet(0);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int32_t xh17_toUnits(xh17Ctxt_t *me, int32_t counts)
+{
+    return calib_toUnits(&me->cal, counts - (int32_t)me->offset);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int32_t xh17_readRawUnits(xh17Ctxt_t *me)
+{
+    return xh17_toUnits(me, xh17_readRaw(me));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int32_t xh17_readFilteredUnits(xh17Ctxt_t *me)
+{
+    return xh17_toUnits(me, xh17_readFiltered(me));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                     Multi-cell group: shared PD_SCK                       //
+////////////////////////////////////////////////////////////////////////////////
+
+void xh17_groupInitHw(xh17Group_t *me)
+{
+    uint8_t mask = me->pins->dOutMask;
+
+    me->channels = 0;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+        if (mask & (1 << bit)) {
+            uint8_t ch = me->channels++;
+
+            me->chBit[ch] = bit;
+            me->offset[ch] = 0;
+            me->trim_q12[ch] = XH17_TRIM_ONE_Q12;
+        }
+    }
+
+    me->pins->initHw();
+
+    xh17_groupSetInputSelect(me, me->inputSelect); // Apply initial input select
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool xh17_groupIsReady(xh17Group_t *me)
+{
+    return me->pins->isReady();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void xh17_groupReadRaw(xh17Group_t *me)
+{
+    uint8_t snap[24];
+    uint8_t pulses;
+
+    switch (me->inputSelect) {
+        case xh17_inputSelect_B_32: pulses = 2; break;
+        case xh17_inputSelect_A_64: pulses = 3; break;
+        default:                    pulses = 1; break;
+    }
+
+    while (!me->pins->isReady());
+
+    me->pins->shiftIn(snap, pulses);
+
+    // Transpose outside the clocked section: bit i of chip ch is in snap[i]
+    for (uint8_t ch = 0; ch < me->channels; ch++) {
+        uint8_t m = (1 << me->chBit[ch]);
+        int32_t count = 0;
+
+        for (uint8_t i = 0; i < 24; i++) {
+            count = count << 1;
+            if (snap[i] & m) {
+                count |= 0x01;
+            }
+        }
+
+        me->raw[ch] = count ^ 0x800000; // Set the sign bit
     }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-int16_t xh17_readRawUnits(xh17Ctxt_t *me)
+void xh17_groupSetInputSelect(xh17Group_t *me, xh17_inputSelect_t inputSelect)
+{
+    me->inputSelect = inputSelect;
+
+    xh17_groupReadRaw(me); // Dummy read to apply new input select
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void xh17_groupTare(xh17Group_t *me, uint8_t samples)
 {
-    return (int16_t)((xh17_readRaw(me) - (int32_t)me->offset) / (int32_t)me->scale);
+    int32_t total[XH17_GROUP_MAX_CHANNELS] = {0};
+
+    if (!samples) {
+        samples = 1;
+    }
+
+    for (uint8_t n = 0; n < samples; n++) {
+        xh17_groupReadRaw(me);
+        for (uint8_t ch = 0; ch < me->channels; ch++) {
+            total[ch] += me->raw[ch];
+        }
+    }
+
+    for (uint8_t ch = 0; ch < me->channels; ch++) {
+        me->offset[ch] = total[ch] / samples;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void xh17_groupSetTrim(xh17Group_t *me, uint8_t channel, uint16_t trim_q12)
+{
+    if (trim_q12 > XH17_TRIM_MAX_Q12) {
+        trim_q12 = XH17_TRIM_MAX_Q12;
+    }
+
+    if (channel < me->channels) {
+        me->trim_q12[channel] = trim_q12;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+int32_t xh17_groupSum(xh17Group_t *me)
+{
+    int32_t sum = 0;
+
+    for (uint8_t ch = 0; ch < me->channels; ch++) {
+        int32_t d = me->raw[ch] - me->offset[ch];
+
+        // d * trim >> 12 without a 64-bit product: split d = hi * 256 + lo.
+        // |hi| <= 2^16 and trim <= 2^13, see XH17_TRIM_MAX_Q12.
+        int32_t hi = (d >> 8) * (int32_t)me->trim_q12[ch];
+        int32_t lo = ((d & 0xFF) * (int32_t)me->trim_q12[ch]) >> 8;
+
+        sum += (hi + lo) >> 4;
+    }
+
+    return sum;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-int16_t xh17_readFilteredUnits(xh17Ctxt_t *me)
+int32_t xh17_groupToUnits(xh17Group_t *me, int32_t sum)
 {
-    return (int16_t)((xh17_readFiltered(me) - (int32_t)me->offset) / (int32_t)me->scale);
+    return calib_toUnits(&me->cal, sum);
 }
@@ -4,84 +4,307 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
-#include <avr/io.h>
-#include <util/delay.h>
+#include "hal_lib.h"
 
-/* Default values for adaptive filter parameters */
+#include "gpio_lib.h"
+#include "time_lib.h"
+#include "filter_lib.h"
+#include "calib_lib.h"
+
+/* Default values for adaptive filter parameters, in gain 128 counts */
 #define XH17_ALPHA_MIN_Q8_DEFAULT   32
 #define XH17_ALPHA_MAX_Q8_DEFAULT   128
-#define XH17_OUT_DEAD_BAND_DEFAULT  1000
-#define XH17_D_LOW_DEFAULT          1500
-#define XH17_D_HIGH_DEFAULT         15000
+#define XH17_OUT_DEAD_BAND_DEFAULT  2000
+#define XH17_D_LOW_DEFAULT          3000
+#define XH17_D_HIGH_DEFAULT         30000
+
+/* Auto zero tracking defaults: disabled until xh17_setZeroTracking() */
+#define XH17_AZT_BAND_DEFAULT       0
+#define XH17_AZT_STEP_DEFAULT       1
+
+/* Depth of the interrupt-driven sample ring, must be a power of two */
+#define XH17_RING_SIZE              16
+
+/* Auto-ranging thresholds on |signed count| with hysteresis: leave gain 128
+above RANGE_HIGH (7/8 of full scale), return below RANGE_LOW at gain 64
+(3/8 of full scale, i.e. 3/4 of full scale at gain 128) */
+#define XH17_RANGE_HIGH             0x700000L
+#define XH17_RANGE_LOW              0x300000L
+
+/* Nominal A128 / A64 gain ratio in Q12 */
+#define XH17_GAIN_RATIO_Q12_DEFAULT 8192
+
+/* Gain 64 conversions averaged by xh17_calibrateRange() */
+#define XH17_RANGE_REF_SAMPLES      4
+
+/* HX711 output settling time, 400 ms at 10 SPS and 50 ms at 80 SPS: four
+conversions at either rate */
+#define XH17_SETTLE_CONVERSIONS     4
+
+/* Conversions dropped after every input / gain switch in async mode */
+#define XH17_SWITCH_DISCARD         XH17_SETTLE_CONVERSIONS
+
+/* Conversions dropped after a RATE change in async mode (output settling) */
+#define XH17_RATE_DISCARD           XH17_SETTLE_CONVERSIONS
+
+/* 80 SPS = 10 SPS * 2^3, used to rescale the filter time constants */
+#define XH17_RATE_SHIFT_80SPS       3
 
 typedef enum {
     xh17_inputSelect_A_128 = 0,
     xh17_inputSelect_B_32,
-    xh17_inputSelect_A_64
+    xh17_inputSelect_A_64,
+    xh17_inputSelect_A_64_ref   // gain 64 reference of xh17_calibrateRange(),
+                                // async only, not for xh17_setInputSelect()
 } xh17_inputSelect_t;
 
+/* SPI backend clock: fosc/8 = 2 MHz at 16 MHz, i.e. 250 ns PD_SCK high time
+which keeps inside the HX711 0.2..50 us window */
+#define XH17_SPI_SPCR   ((1 << SPE) | (1 << MSTR) | (1 << CPHA) | (1 << SPR0))
+#define XH17_SPI_SPSR   (1 << SPI2X)
+
+typedef enum {
+    xh17_rate_10SPS = 0,    // RATE pin low
+    xh17_rate_80SPS         // RATE pin high
+} xh17_rate_t;
+
 typedef enum {
     xh17_mode_Normal = 0,
     xh17_mode_PowerDown
 } xh17_mode_t;
 
+/* Ring entry: raw sample tagged with the input it was converted from and
+the time DOUT signalled it ready, read in the ISR */
+typedef struct {
+    int32_t raw;
+    uint8_t sel;    // xh17_inputSelect_t
+    uint32_t ticks; // time_ticks32(), see time_extend()
+} xh17Sample_t;
+
+/* Pin access generated per context by the declare macros. shiftIn clocks out
+the 24 data bits plus extraPulses gain-select pulses and returns the signed
+sample, pulses clocks n gain-select pulses on their own; everything in them
+is resolved at compile time. */
 typedef struct {
-    volatile uint8_t *pdSckDDR;
-    volatile uint8_t *pdSckPORT;
-    uint8_t pdSckBIT;
+    void (*initHw)(void);
+    uint8_t (*isReady)(void);
+    void (*pdSckSet)(uint8_t high);
+    int32_t (*shiftIn)(uint8_t extraPulses);
+    void (*pulses)(uint8_t n);
 
-    volatile uint8_t *dOutDDR;
-    volatile uint8_t *dOutPORT;
-    volatile uint8_t *dOutPIN;
+    volatile uint8_t *dOutPORT;   // used to pick the pin-change interrupt
     uint8_t dOutBIT;
+} xh17Pins_t;
+
+typedef struct {
+    const xh17Pins_t *pins;
+    void (*rateSet)(uint8_t high);  // NULL if RATE is hard-wired
+    xh17_rate_t rate;
 
     uint32_t offset;
     uint32_t scale;
+    calibCtxt_t cal;        // reciprocal of scale (+ linearization table)
 
-    xh17_inputSelect_t inputSelect;
+    xh17_inputSelect_t inputSelect;     // selection the next conversion gets
+
+    /* Input scheduling in async mode, decided in xh17_irqHandler() between
+    the data bits and the gain pulses of each read. rangeSel is the channel
+    A gain in use; with scanEvery > 0 one channel B sample is taken after
+    every scanEvery channel A samples. */
+    uint8_t autoRange;
+    uint8_t scanEvery;
+    uint8_t scanCount;
+    xh17_inputSelect_t rangeSel;
+    xh17_inputSelect_t convSel;         // selection of the running conversion
+    uint8_t discard;                    // conversions left to drop
+    uint16_t gainRatio_q12;             // A128 / A64, applied by xh17_popRaw()
+    volatile uint16_t convDiscarded;    // conversions dropped after switches
+
+    /* Zero of the gain 64 -> 128 conversion: a gain 64 reading ref64 is
+    ref128 in gain 128 counts. The HX711 offset doesn't scale with the gain,
+    so both are measured at the same (empty) load by xh17_calibrateRange().
+    refLeft is taken by the ISR, refCount and refSum by the consumer. */
+    int32_t ref64;
+    int32_t ref128;
+    volatile uint8_t refLeft;           // reference conversions to schedule
+    uint8_t refCount;                   // reference samples averaged so far
+    int32_t refSum;
+    int32_t lastB;                      // latest channel B sample
+    volatile uint8_t lastBValid;
+
+    /* Filter pipeline used by xh17_filter(). Defaults to adaptive EMA +
+    output dead-band; may be rebuilt with the filter_add*() functions. */
+    filterPipe_t filt;
+
+    /* Interrupt-driven acquisition (single producer / single consumer ring)
+    ringHead is advanced only by xh17_irqHandler(), ringTail only by the
+    consumer, so no locking is needed on 8-bit indexes. */
+    volatile xh17Sample_t ring[XH17_RING_SIZE];
+    volatile uint8_t ringHead;
+    volatile uint8_t ringTail;
+    volatile uint8_t ringDropped;  // samples lost because the ring was full
+    uint8_t pcIdx;                 // pin-change group of DOUT (0..2)
+    volatile uint8_t asyncEn;
 
-    /* Adaptive filter state */
-    int32_t count;         // internal EMA state
-    int32_t countOut;      // stabilized output
-    uint8_t filtInited;     // filter initialization flag
-
-    // Dead-band on output to avoid small fluctuations
-    int32_t outDeadBand;
-
-    /* Adapation thresholds for |x - y| (raw counts)
-    dLow: zone "almost noise" -> alphaMin_q8
-    dHigh: zone "large change" -> alphaMax_q8 */
-    int32_t dLow;
-    int32_t dHigh;
-    uint8_t alphaMin_q8;
-    uint8_t alphaMax_q8;
+    /* Auto zero tracking: while stable and within aztBand of the offset, the
+    offset follows the reading by at most aztStep counts per sample.
+    aztDrift is the total correction applied since the last tare. */
+    int32_t aztBand;
+    uint16_t aztStep;
+    int32_t aztDrift;
 } xh17Ctxt_t;
 
-#define XH17_DECLARE_CTXT(name, pdSckPort, pdSckBit, dOutPort, dOutBit) \
-    xh17Ctxt_t name = { \
-        /* DDR register is PORT - 1 */ \
-        /* PIN register is PORT - 2 */ \
-        .pdSckPORT = &(pdSckPort), \
-        .pdSckDDR = &(pdSckPort) - 1, \
-        .pdSckBIT = (pdSckBit), \
-        .dOutPORT = &(dOutPort), \
-        .dOutDDR = &(dOutPort) - 1, \
-        .dOutPIN = &(dOutPort) - 2, \
-        .dOutBIT = (dOutBit), \
+#define XH17_DELAY_US(us) _delay_us(us) // Placeholder for delay function
+
+#define XH17_CTXT_DEFAULTS \
+        .rate = xh17_rate_10SPS, \
         .offset = 0, \
         .scale = 1, \
+        .cal = { CALIB_CTXT_DEFAULTS }, \
         .inputSelect = xh17_inputSelect_A_128, \
-        .count = 0, \
-        .countOut = 0, \
-        .filtInited = 0, \
-        .alphaMin_q8 = XH17_ALPHA_MIN_Q8_DEFAULT, \
-        .alphaMax_q8 = XH17_ALPHA_MAX_Q8_DEFAULT, \
-        .outDeadBand = XH17_OUT_DEAD_BAND_DEFAULT, \
-        .dLow = XH17_D_LOW_DEFAULT, \
-        .dHigh = XH17_D_HIGH_DEFAULT \
+        .autoRange = 0, \
+        .scanEvery = 0, \
+        .scanCount = 0, \
+        .rangeSel = xh17_inputSelect_A_128, \
+        .convSel = xh17_inputSelect_A_128, \
+        .discard = 0, \
+        .gainRatio_q12 = XH17_GAIN_RATIO_Q12_DEFAULT, \
+        .convDiscarded = 0, \
+        .ref64 = 0x800000L, \
+        .ref128 = 0x800000L, \
+        .refLeft = 0, \
+        .refCount = XH17_RANGE_REF_SAMPLES, \
+        .refSum = 0, \
+        .lastBValid = 0, \
+        .filt = { \
+            .count = 2, \
+            .stage = { \
+                { \
+                    .type = filter_stage_adaptiveEma, \
+                    .ema = { \
+                        .dLow = XH17_D_LOW_DEFAULT, \
+                        .dHigh = XH17_D_HIGH_DEFAULT, \
+                        .alphaMin_q8 = XH17_ALPHA_MIN_Q8_DEFAULT, \
+                        .alphaMax_q8 = XH17_ALPHA_MAX_Q8_DEFAULT, \
+                        .baseMin_q8 = XH17_ALPHA_MIN_Q8_DEFAULT, \
+                        .baseMax_q8 = XH17_ALPHA_MAX_Q8_DEFAULT \
+                    } \
+                }, \
+                { \
+                    .type = filter_stage_deadBand, \
+                    .deadBand = { .band = XH17_OUT_DEAD_BAND_DEFAULT } \
+                } \
+            } \
+        }, \
+        .ringHead = 0, \
+        .ringTail = 0, \
+        .ringDropped = 0, \
+        .asyncEn = 0, \
+        .aztBand = XH17_AZT_BAND_DEFAULT, \
+        .aztStep = XH17_AZT_STEP_DEFAULT, \
+        .aztDrift = 0
+
+/* Bit-banged PD_SCK / DOUT on any two GPIOs */
+#define XH17_DECLARE_PINS(name, pdSckPort, pdSckBit, dOutPort, dOutBit) \
+    GPIO_DECLARE_PIN(name##_pdSck, pdSckPort, pdSckBit) \
+    GPIO_DECLARE_PIN(name##_dOut, dOutPort, dOutBit) \
+    static inline void name##_initHw(void) \
+    { \
+        name##_dOut_setInput(); \
+        name##_dOut_setHigh();  /* pull-up on DOUT */ \
+        name##_pdSck_setOutput(); \
+        name##_pdSck_setLow(); \
+    } \
+    static inline __attribute__((always_inline)) uint8_t name##_isReady(void) \
+    { \
+        return !name##_dOut_read(); \
+    } \
+    static inline __attribute__((always_inline)) void name##_pdSckSet(uint8_t high) \
+    { \
+        if (high) { name##_pdSck_setHigh(); } else { name##_pdSck_setLow(); } \
+        XH17_DELAY_US(1); \
+    } \
+    static inline __attribute__((always_inline)) void name##_pulses(uint8_t n) \
+    { \
+        while (n--) { \
+            name##_pdSck_setHigh(); \
+            XH17_DELAY_US(1); \
+            name##_pdSck_setLow(); \
+            XH17_DELAY_US(1); \
+        } \
+    } \
+    static inline __attribute__((always_inline)) int32_t name##_shiftIn(uint8_t extraPulses) \
+    { \
+        int32_t count = 0; \
+        for (uint8_t i = 0; i < 24; i++) { \
+            name##_pdSck_setHigh(); \
+            XH17_DELAY_US(1); \
+            count = count << 1; \
+            name##_pdSck_setLow(); \
+            XH17_DELAY_US(1); \
+            if (name##_dOut_read()) { count |= 0x01; } \
+        } \
+        name##_pulses(extraPulses); \
+        return count ^ 0x800000; /* Set the sign bit */ \
+    } \
+    static const xh17Pins_t name##_pins = { \
+        .initHw = name##_initHw, \
+        .isReady = name##_isReady, \
+        .pdSckSet = name##_pdSckSet, \
+        .shiftIn = name##_shiftIn, \
+        .pulses = name##_pulses, \
+        .dOutPORT = &(dOutPort), \
+        .dOutBIT = (dOutBit) \
     };
 
-#define XH17_DELAY_US(us) _delay_us(us) // Placeholder for delay function
+/* name_irqHandler(): xh17_irqHandler() of this context with its pin table
+known at compile time, so the pin accesses are inlined instead of called
+through the table. Route the PCINTx_vect of DOUT to it. */
+#define XH17_DECLARE_IRQ_HANDLER(name) \
+    static inline void name##_irqHandler(void) \
+    { \
+        xh17_irqService(&name, &name##_pins); \
+    }
+
+#define XH17_DECLARE_CTXT(name, pdSckPort, pdSckBit, dOutPort, dOutBit) \
+    XH17_DECLARE_PINS(name, pdSckPort, pdSckBit, dOutPort, dOutBit) \
+    xh17Ctxt_t name = { \
+        .pins = &name##_pins, \
+        .rateSet = NULL, \
+        XH17_CTXT_DEFAULTS \
+    }; \
+    XH17_DECLARE_IRQ_HANDLER(name)
+
+/* Same as XH17_DECLARE_CTXT with the HX711 RATE pin on a GPIO, which allows
+switching between 10 and 80 SPS with xh17_setRate() */
+#define XH17_DECLARE_CTXT_RATE(name, pdSckPort, pdSckBit, dOutPort, dOutBit, ratePort, rateBit) \
+    XH17_DECLARE_PINS(name, pdSckPort, pdSckBit, dOutPort, dOutBit) \
+    GPIO_DECLARE_PIN(name##_rate, ratePort, rateBit) \
+    static void name##_rateSet(uint8_t high) \
+    { \
+        name##_rate_setOutput(); \
+        if (high) { name##_rate_setHigh(); } else { name##_rate_setLow(); } \
+    } \
+    xh17Ctxt_t name = { \
+        .pins = &name##_pins, \
+        .rateSet = name##_rateSet, \
+        XH17_CTXT_DEFAULTS \
+    }; \
+    XH17_DECLARE_IRQ_HANDLER(name)
+
+/* Pin table of the hardware SPI backend, see XH17_DECLARE_CTXT_SPI */
+extern const xh17Pins_t xh17_spiPins;
+
+/* Same as XH17_DECLARE_CTXT, but the 24 data bits are shifted in by the
+hardware SPI in three byte transfers (SPI mode 1, sampled on the falling
+PD_SCK edge). PD_SCK must be wired to SCK (PB5) and DOUT to MISO (PB4);
+SS (PB2) is driven as output to keep the SPI in master mode. */
+#define XH17_DECLARE_CTXT_SPI(name) \
+    xh17Ctxt_t name = { \
+        .pins = &xh17_spiPins, \
+        .rateSet = NULL, \
+        XH17_CTXT_DEFAULTS \
+    };
 
 /**
  * @fn xh17_initHw
@@ -122,11 +345,213 @@ int32_t xh17_readRaw(xh17Ctxt_t *me);
  */
 int32_t xh17_readRawAvg(xh17Ctxt_t *me, uint8_t samples);
 
+/**
+ * @fn xh17_startAsync
+ * @param me     - Pointer to the XH17 context structure.
+ * @brief Enable pin-change interrupt on DOUT. Conversions are then clocked
+ *        out by xh17_irqHandler() and queued in the sample ring; blocking
+ *        reads (xh17_readRaw() and friends) take samples from the ring.
+ * @note  The application must route the PCINTx_vect of the DOUT port to
+ *        name_irqHandler() (or xh17_irqHandler()).
+ */
+void xh17_startAsync(xh17Ctxt_t *me);
+
+/**
+ * @fn xh17_stopAsync
+ * @param me     - Pointer to the XH17 context structure.
+ * @brief Disable interrupt-driven acquisition and drop queued samples.
+ */
+void xh17_stopAsync(xh17Ctxt_t *me);
+
+/**
+ * @fn xh17_irqHandler
+ * @param me     - Pointer to the XH17 context structure.
+ * @brief Pin-change ISR body: if a conversion is ready, clock it out and
+ *        push it into the sample ring. Pin access goes through me->pins;
+ *        the name_irqHandler() generated by the declare macros avoids that.
+ */
+void xh17_irqHandler(xh17Ctxt_t *me);
+
+/**
+ * @fn xh17_irqSelect
+ * @param me     - Pointer to the XH17 context structure.
+ * @param sel    - Input the conversion just read was taken from.
+ * @param count  - Its data bits.
+ * @brief Part of xh17_irqService(): decide whether to keep the sample and
+ *        pick the input of the next conversion (me->inputSelect).
+ * @return true if the sample is kept.
+ */
+bool xh17_irqSelect(xh17Ctxt_t *me, uint8_t sel, int32_t count);
+
+/**
+ * @fn xh17_irqPush
+ * @param me     - Pointer to the XH17 context structure.
+ * @param sel    - Input the sample was taken from.
+ * @param count  - Sample to queue.
+ * @param ticks  - time_ticks32() of the ready edge.
+ * @brief Part of xh17_irqService(): put a kept sample into the ring.
+ */
+void xh17_irqPush(xh17Ctxt_t *me, uint8_t sel, int32_t count, uint32_t ticks);
+
+/**
+ * @fn xh17_gainPulses
+ * @param sel    - Input selection of the next conversion.
+ * @return Gain-select pulses after the 24 data bits (1..3).
+ */
+static inline uint8_t xh17_gainPulses(uint8_t sel)
+{
+    switch (sel) {
+        case xh17_inputSelect_B_32: return 2;
+        case xh17_inputSelect_A_64:
+        case xh17_inputSelect_A_64_ref: return 3;
+        default:                        return 1;
+    }
+}
+
+/**
+ * @fn xh17_irqService
+ * @param me     - Pointer to the XH17 context structure.
+ * @param pins   - Its pin table.
+ * @brief Body of xh17_irqHandler(). Inlined with a constant pin table, the
+ *        data bits and gain pulses are clocked without calls.
+ */
+static inline __attribute__((always_inline))
+void xh17_irqService(xh17Ctxt_t *me, const xh17Pins_t *pins)
+{
+    uint8_t sel = me->convSel;
+    bool keep;
+    int32_t count;
+    uint32_t ticks;
+
+    // Pin change fires on both edges, only the falling one means "ready"
+    if (!pins->isReady()) {
+        return;
+    }
+
+    // Conversion time: the ready edge, not when the consumer gets to it
+    ticks = time_ticks32();
+
+    // Data bits first, the gain pulses after deciding on the next input
+    HAL_MARK(HAL_MARK_XH17_READ);
+    count = pins->shiftIn(0);
+    keep = xh17_irqSelect(me, sel, count);
+    pins->pulses(xh17_gainPulses(me->inputSelect));
+    me->convSel = me->inputSelect;
+    HAL_MARK(HAL_MARK_XH17_READ | HAL_MARK_END);
+
+    // DOUT toggled while clocking, drop the edges we caused ourselves
+    PCIFR = (1 << me->pcIdx);
+
+    if (keep) {
+        xh17_irqPush(me, sel, count, ticks);
+    }
+}
+
+/**
+ * @fn xh17_available
+ * @param me     - Pointer to the XH17 context structure.
+ * @return Number of samples waiting in the ring.
+ */
+uint8_t xh17_available(xh17Ctxt_t *me);
+
+/**
+ * @fn xh17_popRaw
+ * @param me     - Pointer to the XH17 context structure.
+ * @param raw    - Where to store the oldest queued sample.
+ * @brief Take one channel A sample from the ring without blocking. With
+ *        auto-ranging, gain 64 samples are scaled to gain 128 counts by
+ *        gainRatio_q12. Channel B samples are skipped, see xh17_getChannelB().
+ * @return true if a sample was taken, false if the ring was empty.
+ */
+bool xh17_popRaw(xh17Ctxt_t *me, int32_t *raw);
+
+/**
+ * @fn xh17_popSample
+ * @param me     - Pointer to the XH17 context structure.
+ * @param s      - Where to store the oldest queued sample, as converted,
+ *                 with its conversion time.
+ * @brief Take one sample of any input from the ring without blocking.
+ * @return true if a sample was taken, false if the ring was empty.
+ */
+bool xh17_popSample(xh17Ctxt_t *me, xh17Sample_t *s);
+
+/**
+ * @fn xh17_sampleToRaw
+ * @param me     - Pointer to the XH17 context structure.
+ * @param s      - Sample from xh17_popSample() (or a recorded trace).
+ * @param raw    - Where to store the channel A value.
+ * @brief The per-sample part of xh17_popRaw(): channel B is kept for
+ *        xh17_getChannelB(), gain 64 samples are scaled when auto-ranging,
+ *        reference samples go to xh17_calibrateRange().
+ * @return false for a channel B or reference sample, nothing is stored in
+ *         raw then.
+ */
+bool xh17_sampleToRaw(xh17Ctxt_t *me, const xh17Sample_t *s, int32_t *raw);
+
+/**
+ * @fn xh17_getChannelB
+ * @param me     - Pointer to the XH17 context structure.
+ * @param raw    - Where to store the latest channel B sample.
+ * @brief Latest channel B sample skipped by xh17_popRaw() during a scan.
+ * @return true if a new sample was stored since the last call.
+ */
+bool xh17_getChannelB(xh17Ctxt_t *me, int32_t *raw);
+
+/**
+ * @fn xh17_setAutoRange
+ * @param me     - Pointer to the XH17 context structure.
+ * @param enable - 1: switch channel A between gain 128 and 64 as needed.
+ * @brief Auto-ranging (async mode). Readings are then in gain 128 counts,
+ *        so the calibration must be done with auto-ranging on. Disabling
+ *        keeps the current gain, xh17_setInputSelect() picks another.
+ */
+void xh17_setAutoRange(xh17Ctxt_t *me, uint8_t enable);
+
+/**
+ * @fn xh17_setGainRatio
+ * @param me          - Pointer to the XH17 context structure.
+ * @param ratio_q12   - Measured A128 / A64 gain ratio in Q12.
+ * @brief Correction applied to gain 64 samples while auto-ranging:
+ *        ref128 + (raw - ref64) * ratio.
+ */
+void xh17_setGainRatio(xh17Ctxt_t *me, uint16_t ratio_q12);
+
+/**
+ * @fn xh17_calibrateRange
+ * @param me     - Pointer to the XH17 context structure.
+ * @brief Measure the zero of the gain 64 range (async mode, auto-ranging):
+ *        the next XH17_RANGE_REF_SAMPLES channel A conversions are taken at
+ *        gain 64 and averaged into ref64, the current offset becomes
+ *        ref128. Call right after a tare, while the platform is empty.
+ *        Without it gain 64 readings are scaled around 0x800000 and jump
+ *        by 2 * offset64 - offset128 at a range switch.
+ */
+void xh17_calibrateRange(xh17Ctxt_t *me);
+
+/**
+ * @fn xh17_setScan
+ * @param me     - Pointer to the XH17 context structure.
+ * @param every  - One channel B sample per this many A samples, 0 = off.
+ * @brief Interleave channel B (gain 32) conversions (async mode).
+ */
+void xh17_setScan(xh17Ctxt_t *me, uint8_t every);
+
+/**
+ * @fn xh17_sampleRate_cHz
+ * @param me     - Pointer to the XH17 context structure.
+ * @brief Channel A sample rate left after scan overhead: each B sample
+ *        costs 1 + 2 * XH17_SWITCH_DISCARD conversions. Range switches
+ *        cost XH17_SWITCH_DISCARD more each (counted in convDiscarded).
+ * @return Samples per 100 s.
+ */
+uint16_t xh17_sampleRate_cHz(xh17Ctxt_t *me);
+
 /**
  * @fn xh17_setInputSelect
  * @param me         - Pointer to the XH17 context structure.
  * @param inputSelect   - Input selection mode.
- * @brief Set the input selection mode for the XH17 sensor.
+ * @brief Set the input selection mode for the XH17 sensor. A channel A
+ *        selection also becomes the auto-ranging start gain.
  */
 void xh17_setInputSelect(xh17Ctxt_t *me, xh17_inputSelect_t inputSelect);
 
@@ -138,26 +563,81 @@ void xh17_setInputSelect(xh17Ctxt_t *me, xh17_inputSelect_t inputSelect);
 */
 int32_t xh17_readFiltered(xh17Ctxt_t *me);
 
+/**
+ * @fn xh17_filter
+ * @param me     - Pointer to the XH17 context structure.
+ * @param raw    - Raw sample, e.g. taken with xh17_popRaw().
+ * @brief Feed one raw sample through the filter pipeline (me->filt).
+ * @return Filtered data.
+ */
+int32_t xh17_filter(xh17Ctxt_t *me, int32_t raw);
+
+/**
+ * @fn xh17_toUnits
+ * @param me     - Pointer to the XH17 context structure.
+ * @param counts - Raw or filtered counts.
+ * @brief Apply offset and scale to a reading.
+ */
+int32_t xh17_toUnits(xh17Ctxt_t *me, int32_t counts);
+
 /**
  * @fn xh17_tare
  * @param me - Pointer to the XH17 context structure.
- * @brief Set the current filtered reading as the offset (tare).
+ * @brief Set the current filtered reading as the offset (tare). Blocks for
+ *        one conversion; calproc_lib provides an averaged, non-blocking tare.
  */
 void xh17_tare(xh17Ctxt_t *me);
 
+/**
+ * @fn xh17_setZeroTracking
+ * @param me     - Pointer to the XH17 context structure.
+ * @param band   - Track only within +-band counts of the offset, 0 disables.
+ * @param step   - Max offset change per tracked sample, counts.
+ * @brief Configure automatic zero tracking.
+ */
+void xh17_setZeroTracking(xh17Ctxt_t *me, int32_t band, uint16_t step);
+
+/**
+ * @fn xh17_zeroTrack
+ * @param me       - Pointer to the XH17 context structure.
+ * @param filtered - Filtered reading, e.g. from xh17_filter().
+ * @param stable   - Reading is at rest (see stable_lib).
+ * @brief Pull the offset toward a stable reading near zero to cancel creep
+ *        and temperature drift. Call once per sample.
+ */
+void xh17_zeroTrack(xh17Ctxt_t *me, int32_t filtered, bool stable);
+
+/**
+ * @fn xh17_getDrift
+ * @param me     - Pointer to the XH17 context structure.
+ * @return Offset correction applied by zero tracking since the offset was
+ *         last set.
+ */
+int32_t xh17_getDrift(xh17Ctxt_t *me);
+
 /**
  * @fn xh17_setScale
  * @param me    - Pointer to the XH17 context structure.
- * @param scale   - Scale factor to apply to readings.
- * @brief Set the scale factor for the XH17 sensor readings.
+ * @param scale   - Counts per unit.
+ * @brief Set the scale factor and precompute its reciprocal (me->cal).
  */
 void xh17_setScale(xh17Ctxt_t *me, uint32_t scale);
 
+/**
+ * @fn xh17_setSpan
+ * @param me         - Pointer to the XH17 context structure.
+ * @param spanCounts - Offset-corrected counts at the reference load.
+ * @param spanUnits  - Reference load in output units.
+ * @brief Full precision alternative to xh17_setScale(), see calib_setSpan().
+ */
+void xh17_setSpan(xh17Ctxt_t *me, int32_t spanCounts, int32_t spanUnits);
+
 /**
  * @fn xh17_setOffset
  * @param me     - Pointer to the XH17 context structure.
  * @param offset   - Offset value to set.
- * @brief Set the offset for the XH17 sensor readings.
+ * @brief Set the offset for the XH17 sensor readings and clear the zero
+ *        tracking drift counter.
  */
 void xh17_setOffset(xh17Ctxt_t *me, uint32_t offset);
 
@@ -169,12 +649,24 @@ void xh17_setOffset(xh17Ctxt_t *me, uint32_t offset);
  * @param alphaMin_q8    - Minimum alpha value in Q8 format.
  * @param alphaMax_q8    - Maximum alpha value in Q8 format.
  * @param outDeadBand    - Dead-band for output stabilization.
- * @brief Set the parameters for the adaptive filter.
+ * @brief Rebuild the filter pipeline as adaptive EMA + output dead-band
+ *        with the given parameters. The filter restarts from the next sample.
  */
 void xh17_setFilterParams(xh17Ctxt_t *me, int32_t dLow, int32_t dHigh,
                             uint8_t alphaMin_q8, uint8_t alphaMax_q8,
                             int32_t outDeadBand);
 
+/**
+ * @fn xh17_setRate
+ * @param me     - Pointer to the XH17 context structure.
+ * @param rate   - Output data rate.
+ * @brief Drive the RATE pin and rescale the filter so its settling time in
+ *        ms stays the same. In async mode the XH17_RATE_DISCARD conversions
+ *        the HX711 needs to settle are dropped.
+ * @return false if the context has no RATE pin.
+ */
+bool xh17_setRate(xh17Ctxt_t *me, xh17_rate_t rate);
+
 /**
  * @fn xh17_setMode
  * @param me     - Pointer to the XH17 context structure.
@@ -188,14 +680,157 @@ void xh17_setMode(xh17Ctxt_t *me, xh17_mode_t mode);
  * @param me     - Pointer to the XH17 context structure.
  * @brief Read raw data in units from the XH17 sensor.
  */
-int16_t xh17_readRawUnits(xh17Ctxt_t *me);
+int32_t xh17_readRawUnits(xh17Ctxt_t *me);
 
 /**
  * @fn xh17_readFilteredUnits
  * @param me     - Pointer to the XH17 context structure.
  * @brief Read filtered data in units from the XH17 sensor.
  */
-int16_t xh17_readFilteredUnits(xh17Ctxt_t *me);
+int32_t xh17_readFilteredUnits(xh17Ctxt_t *me);
+
+/******************************************************************************/
+/*                  Multi-cell group: shared PD_SCK, DOUTs on one port        */
+/******************************************************************************/
+
+#define XH17_GROUP_MAX_CHANNELS     8
+
+/* Per-cell gain trim (corner balancing), Q12: 4096 = 1.0. Trims are clamped
+to XH17_TRIM_MAX_Q12 (2.0): with |counts| < 2^24 the trimmed product then
+stays below 2^29 in xh17_groupSum(). */
+#define XH17_TRIM_ONE_Q12           4096
+#define XH17_TRIM_MAX_Q12           (2 * XH17_TRIM_ONE_Q12)
+
+/* Pin access generated by XH17_DECLARE_GROUP. shiftIn stores one snapshot
+of the whole DOUT port per clock, snap[0] holding the MSB of every chip. */
+typedef struct {
+    void (*initHw)(void);
+    uint8_t (*isReady)(void);
+    void (*shiftIn)(uint8_t *snap, uint8_t extraPulses);
+
+    uint8_t dOutMask;
+} xh17GroupPins_t;
+
+typedef struct {
+    const xh17GroupPins_t *pins;
+
+    xh17_inputSelect_t inputSelect;
+    uint8_t channels;                           // number of bits in dOutMask
+    uint8_t chBit[XH17_GROUP_MAX_CHANNELS];     // DOUT bit of each channel
+
+    int32_t raw[XH17_GROUP_MAX_CHANNELS];       // last sample per channel
+    int32_t offset[XH17_GROUP_MAX_CHANNELS];
+    uint16_t trim_q12[XH17_GROUP_MAX_CHANNELS];
+    calibCtxt_t cal;                            // sum -> units, see calib_setSpan()
+} xh17Group_t;
+
+/* Up to 8 HX711 sharing one PD_SCK line, DOUT pins on the same port, one
+bit per chip in dOutBits. Channels are numbered from the lowest bit. */
+#define XH17_DECLARE_GROUP(name, pdSckPort, pdSckBit, dOutPort, dOutBits) \
+    GPIO_DECLARE_PIN(name##_pdSck, pdSckPort, pdSckBit) \
+    static void name##_initHw(void) \
+    { \
+        GPIO_DDR(dOutPort) &= (uint8_t)~(dOutBits); \
+        (dOutPort) |= (uint8_t)(dOutBits);  /* pull-ups on DOUT */ \
+        name##_pdSck_setOutput(); \
+        name##_pdSck_setLow(); \
+    } \
+    static uint8_t name##_isReady(void) \
+    { \
+        return (GPIO_PIN(dOutPort) & (dOutBits)) == 0; \
+    } \
+    static void name##_shiftIn(uint8_t *snap, uint8_t extraPulses) \
+    { \
+        for (uint8_t i = 0; i < 24; i++) { \
+            name##_pdSck_setHigh(); \
+            XH17_DELAY_US(1); \
+            name##_pdSck_setLow(); \
+            XH17_DELAY_US(1); \
+            snap[i] = GPIO_PIN(dOutPort); \
+        } \
+        while (extraPulses--) { \
+            name##_pdSck_setHigh(); \
+            XH17_DELAY_US(1); \
+            name##_pdSck_setLow(); \
+            XH17_DELAY_US(1); \
+        } \
+    } \
+    static const xh17GroupPins_t name##_pins = { \
+        .initHw = name##_initHw, \
+        .isReady = name##_isReady, \
+        .shiftIn = name##_shiftIn, \
+        .dOutMask = (dOutBits) \
+    }; \
+    xh17Group_t name = { \
+        .pins = &name##_pins, \
+        .inputSelect = xh17_inputSelect_A_128, \
+        .cal = { CALIB_CTXT_DEFAULTS } \
+    };
+
+/**
+ * @fn xh17_groupInitHw
+ * @param me     - Pointer to the XH17 group structure.
+ * @brief Initialize the shared interface, reset offsets and trims.
+ */
+void xh17_groupInitHw(xh17Group_t *me);
+
+/**
+ * @fn xh17_groupIsReady
+ * @param me     - Pointer to the XH17 group structure.
+ * @return true when every chip in the group has a conversion ready.
+ */
+bool xh17_groupIsReady(xh17Group_t *me);
+
+/**
+ * @fn xh17_groupReadRaw
+ * @param me     - Pointer to the XH17 group structure.
+ * @brief Wait for all chips and read them in one pass: each PD_SCK edge
+ *        captures one bit of every chip with a single PIN read. Results go
+ *        to me->raw[].
+ */
+void xh17_groupReadRaw(xh17Group_t *me);
+
+/**
+ * @fn xh17_groupSetInputSelect
+ * @param me          - Pointer to the XH17 group structure.
+ * @param inputSelect - Input selection mode, applied to all chips.
+ * @brief Set the input selection mode and perform the dummy read.
+ */
+void xh17_groupSetInputSelect(xh17Group_t *me, xh17_inputSelect_t inputSelect);
+
+/**
+ * @fn xh17_groupTare
+ * @param me      - Pointer to the XH17 group structure.
+ * @param samples - Number of reads to average per channel.
+ * @brief Set every channel offset from its averaged reading.
+ */
+void xh17_groupTare(xh17Group_t *me, uint8_t samples);
+
+/**
+ * @fn xh17_groupSetTrim
+ * @param me       - Pointer to the XH17 group structure.
+ * @param channel  - Channel index.
+ * @param trim_q12 - Gain trim of the cell, XH17_TRIM_ONE_Q12 = 1.0.
+ * @brief Set the corner balancing trim of one load cell, at most
+ *        XH17_TRIM_MAX_Q12.
+ */
+void xh17_groupSetTrim(xh17Group_t *me, uint8_t channel, uint16_t trim_q12);
+
+/**
+ * @fn xh17_groupSum
+ * @param me     - Pointer to the XH17 group structure.
+ * @brief Sum of offset-corrected, trimmed counts of the last read.
+ * @return Balanced platform reading in counts.
+ */
+int32_t xh17_groupSum(xh17Group_t *me);
+
+/**
+ * @fn xh17_groupToUnits
+ * @param me     - Pointer to the XH17 group structure.
+ * @param sum    - Value returned by xh17_groupSum().
+ * @brief Apply the group calibration to a summed reading.
+ */
+int32_t xh17_groupToUnits(xh17Group_t *me, int32_t sum);
 
 /* _XH17_LIB_H_ */
 #endif
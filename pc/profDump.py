@@ -0,0 +1,60 @@
+"""Print the cycle profile of the scales firmware (prof_lib).
+
+Sends the profile command ("p;") every interval and prints the table the
+firmware answers with. Each dump covers the time since the previous one.
+
+    python profDump.py COM3 --interval 5
+"""
+
+import argparse
+import time
+
+import serial
+
+from telemetry import FrameDecoder, TLM_TYPE_PROFILE
+
+CMD_PROFILE = b"p;"
+F_CPU = 16e6
+
+
+def print_table(frame):
+    us = 1e6 / F_CPU
+    print(f"{'region':<10} {'count':>7} {'min':>7} {'mean':>9} {'max':>7}"
+          f"   cycles (timer overhead {frame.overhead} removed)")
+    for e in frame.profile:
+        if not e.count:
+            print(f"{e.name:<10} {0:>7}")
+            continue
+        print(f"{e.name:<10} {e.count:>7} {e.min:>7} {e.mean:>9.1f} {e.max:>7}"
+              f"   {e.mean * us:8.2f} us mean")
+    print()
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("port")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--interval", type=float, default=5.0)
+    ap.add_argument("--count", type=int, default=0, help="dumps, 0 = until Ctrl+C")
+    args = ap.parse_args()
+
+    decoder = FrameDecoder()
+    dumps = 0
+
+    with serial.Serial(args.port, args.baud, timeout=0.1) as ser:
+        ser.reset_input_buffer()
+        try:
+            while not args.count or dumps < args.count:
+                ser.write(CMD_PROFILE)
+                end = time.monotonic() + args.interval
+                while time.monotonic() < end:
+                    for frame in decoder.feed(ser.read(256)):
+                        if frame.type == TLM_TYPE_PROFILE:
+                            print_table(frame)
+                            dumps += 1
+        except KeyboardInterrupt:
+            pass
+
+
+if __name__ == "__main__":
+    main()
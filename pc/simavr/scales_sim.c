@@ -0,0 +1,569 @@
+/*
+ * simavr harness for the scales firmware.
+ *
+ * Runs the AVR build of src/main.c (PlatformIO env "sim", which adds the
+ * GPIOR0 region markers of hal_lib.h) against:
+ *   - a virtual HX711 on PD5 (PD_SCK) / PD6 (DOUT) / PD7 (RATE), converting
+ *     at 10 or 80 SPS and playing a weight script,
+ *   - a virtual TM1637 on PD4 (CLK) / PD3 (DIO) that decodes and ACKs the bus,
+ *   - a UART sink that counts COBS frames and can save the raw stream for
+ *     pc/telemetry.py.
+ *
+ * At the end it prints, in CPU cycles at 16 MHz:
+ *   - per marked region (HX711 readout, tm1637_print, telemetry frame,
+ *     fmt_fixed of the display string): count, min, mean and max. Nested marked regions are subtracted from the outer
+ *     one; unmarked ISRs (Timer0, Timer2, UDRE) are not, so compare the min
+ *     column between builds and look at max for interrupt interference.
+ *   - the TM1637 bus time per display update,
+ *   - sample-to-UART latency: from the HX711 conversion whose sample went into
+ *     a telemetry frame last, to the frame delimiter being written to UDR0.
+ *
+ * The "sim_fmt" build also renders each display string with snprintf into a
+ * scratch buffer, marked separately, to compare the two on the AVR itself:
+ *   pio run -e sim_fmt && make -C pc/simavr run FIRMWARE=../../.pio/build/sim_fmt/firmware.elf
+ * and the "sim_gpio" build times a pin set + clear at start-up through
+ * GPIO_DECLARE_PIN, a pointer + bit index (the old driver path) and
+ * digitalWrite(), see gpio_lib.h.
+ *
+ * Usage: scales_sim [-t seconds] [-s script] [-n noise] [-o uart.bin] firmware.elf
+ *
+ * Exit status is 1 when the run is not usable for comparing builds: the CPU
+ * stopped, no HX711 readout marker or no telemetry frame was seen, or the
+ * markers were unbalanced.
+ *
+ * Weight script: one "<seconds> <counts>" pair per line, '#' comments. The
+ * HX711 reports the counts of the last line whose time has passed, plus
+ * uniform noise of +/- noise counts. Channel B reads a fixed value.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include "sim_cycle_timers.h"
+#include "avr_ioport.h"
+#include "avr_uart.h"
+
+/******************************************************************************/
+/*                             Internal definitions                           */
+/******************************************************************************/
+#define SIM_MCU             "atmega328p"
+#define SIM_FREQ            16000000UL
+
+/* Must match hal_lib.h */
+#define MARK_XH17_READ      1
+#define MARK_TM1637_PRINT   2
+#define MARK_TLM_FRAME      3
+#define MARK_FMT            4
+#define MARK_FMT_REF        5
+#define MARK_GPIO_INLINE    6
+#define MARK_GPIO_PTR       7
+#define MARK_GPIO_ARDUINO   8
+#define MARK_END            0x80
+#define MARK_COUNT          9
+
+#define MARK_STACK_DEPTH    8
+
+#define GPIOR0_ADDR         0x3E
+
+#define HX_PERIOD_10SPS_US  100000
+#define HX_PERIOD_80SPS_US  12500
+#define HX_CHANNEL_B        12345
+
+/* A bus pause longer than this ends a TM1637 display update */
+#define TM_UPDATE_GAP_US    200
+
+#define SCRIPT_MAX          64
+
+typedef struct {
+    const char *name;
+    uint32_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+} stat_t;
+
+typedef struct {
+    uint8_t id;
+    avr_cycle_count_t start;
+    avr_cycle_count_t nested;
+} markFrame_t;
+
+static avr_t *avr;
+
+static struct {
+    double t;
+    int32_t counts;
+} script[SCRIPT_MAX] = {
+    { 0.0, 80000 },      // empty platform
+    { 3.0, 500000 },     // load placed
+    { 6.0, 80000 }       // load removed
+};
+static uint8_t scriptLen = 3;
+static int32_t noise;
+static uint32_t lcg = 1;
+
+static stat_t marks[MARK_COUNT] = {
+    [MARK_XH17_READ] = { .name = "HX711 readout" },
+    [MARK_TM1637_PRINT] = { .name = "tm1637_print" },
+    [MARK_TLM_FRAME] = { .name = "telemetry frame" },
+    [MARK_FMT] = { .name = "fmt_fixed" },
+    [MARK_FMT_REF] = { .name = "snprintf fixed" },
+    [MARK_GPIO_INLINE] = { .name = "pin inline" },
+    [MARK_GPIO_PTR] = { .name = "pin pointer+bit" },
+    [MARK_GPIO_ARDUINO] = { .name = "pin digitalWrite" },
+};
+static markFrame_t markStack[MARK_STACK_DEPTH];
+static uint8_t markDepth;
+static uint32_t markErrors;
+
+static stat_t tmUpdate = { .name = "TM1637 bus update" };
+static stat_t latency = { .name = "sample to UART" };
+
+/* Virtual HX711 */
+static struct {
+    avr_irq_t *dout;
+    uint8_t sck;
+    uint8_t pulses;         // PD_SCK rising edges since DOUT went low
+    uint8_t gainPulses;     // 25..27, selects the next conversion
+    uint8_t rate80;
+    uint32_t data;          // 24-bit two's complement
+    avr_cycle_count_t readyAt;
+    avr_cycle_count_t readAt;   // ready time of the last sample read out
+} hx = { .gainPulses = 25 };
+
+/* Virtual TM1637 */
+static struct {
+    avr_irq_t *dio;
+    uint8_t clk;
+    uint8_t dioLevel;
+    uint8_t driving;        // our own ACK on DIO, ignore its notification
+    uint8_t active;
+    uint8_t bit;
+    uint8_t bytes;
+    avr_cycle_count_t updateStart;
+    avr_cycle_count_t lastStop;
+    uint8_t inUpdate;
+    uint32_t transactions;
+} tm;
+
+/* UART sink */
+static FILE *uartOut;
+static uint32_t uartBytes;
+static uint32_t uartFrames;
+static avr_cycle_count_t frameSampleAt;
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+static void statAdd(stat_t *s, uint64_t v)
+{
+    if (!s->count || v < s->min) {
+        s->min = v;
+    }
+    if (v > s->max) {
+        s->max = v;
+    }
+    s->sum += v;
+    s->count++;
+}
+
+static void statPrint(const stat_t *s)
+{
+    double us = 1e6 / SIM_FREQ;
+
+    if (!s->count) {
+        printf("%-20s %8s\n", s->name, "-");
+        return;
+    }
+
+    printf("%-20s %8u %10llu %10.0f %10llu   %9.1f us mean\n", s->name, s->count,
+           (unsigned long long)s->min, (double)s->sum / s->count,
+           (unsigned long long)s->max, (double)s->sum / s->count * us);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static int32_t scriptCounts(double t)
+{
+    int32_t counts = script[0].counts;
+
+    for (uint8_t i = 0; i < scriptLen; i++) {
+        if (script[i].t <= t) {
+            counts = script[i].counts;
+        }
+    }
+
+    if (noise) {
+        lcg = lcg * 1664525UL + 1013904223UL;
+        counts += (int32_t)((lcg >> 8) % (uint32_t)(2 * noise + 1)) - noise;
+    }
+
+    return counts;
+}
+
+static int loadScript(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[128];
+
+    if (!f) {
+        return -1;
+    }
+
+    scriptLen = 0;
+    while (fgets(line, sizeof(line), f) && (scriptLen < SCRIPT_MAX)) {
+        double t;
+        long counts;
+
+        if ((line[0] == '#') || (sscanf(line, "%lf %ld", &t, &counts) != 2)) {
+            continue;
+        }
+        script[scriptLen].t = t;
+        script[scriptLen].counts = (int32_t)counts;
+        scriptLen++;
+    }
+    fclose(f);
+
+    return scriptLen ? 0 : -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void markWrite(struct avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param)
+{
+    uint8_t id = v & ~MARK_END;
+    avr_cycle_count_t now = avr->cycle;
+
+    (void)param;
+    avr->data[addr] = v;
+
+    if (!id || (id >= MARK_COUNT)) {
+        markErrors++;
+        return;
+    }
+
+    if (!(v & MARK_END)) {
+        if (markDepth < MARK_STACK_DEPTH) {
+            markStack[markDepth].id = id;
+            markStack[markDepth].start = now;
+            markStack[markDepth].nested = 0;
+        }
+        markDepth++;
+
+        if (id == MARK_TLM_FRAME) {
+            frameSampleAt = hx.readAt;
+        }
+        return;
+    }
+
+    if (!markDepth || (markDepth > MARK_STACK_DEPTH) ||
+        (markStack[markDepth - 1].id != id)) {
+        markErrors++;
+        markDepth = 0;
+        return;
+    }
+
+    markDepth--;
+    statAdd(&marks[id], now - markStack[markDepth].start - markStack[markDepth].nested);
+    if (markDepth) {
+        markStack[markDepth - 1].nested += now - markStack[markDepth].start;
+    }
+
+    if (id == MARK_XH17_READ) {
+        hx.readAt = hx.readyAt;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static avr_cycle_count_t hxConvert(struct avr_t *avr, avr_cycle_count_t when, void *param)
+{
+    uint32_t periodUs = hx.rate80 ? HX_PERIOD_80SPS_US : HX_PERIOD_10SPS_US;
+    int32_t counts;
+
+    (void)param;
+
+    // A read in progress holds the output register
+    if ((hx.pulses == 0) || (hx.pulses >= 25)) {
+        if (hx.pulses >= 25) {
+            hx.gainPulses = hx.pulses;
+        }
+
+        counts = scriptCounts((double)when / SIM_FREQ);
+        if (hx.gainPulses == 26) {
+            counts = HX_CHANNEL_B;
+        } else if (hx.gainPulses == 27) {
+            counts /= 2;
+        }
+
+        hx.data = (uint32_t)counts & 0xFFFFFF;
+        hx.pulses = 0;
+        hx.readyAt = when;
+        avr_raise_irq(hx.dout, 0);
+    }
+
+    return when + avr_usec_to_cycles(avr, periodUs);
+}
+
+static void hxSck(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    (void)irq;
+    (void)param;
+
+    if (value && !hx.sck) {
+        hx.pulses++;
+        if (hx.pulses <= 24) {
+            avr_raise_irq(hx.dout, (hx.data >> (24 - hx.pulses)) & 1);
+        } else if (hx.pulses == 25) {
+            avr_raise_irq(hx.dout, 1);
+        }
+    }
+    hx.sck = value ? 1 : 0;
+}
+
+static void hxRate(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    (void)irq;
+    (void)param;
+
+    hx.rate80 = value ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void tmAck(uint8_t low)
+{
+    tm.driving = 1;
+    avr_raise_irq(tm.dio, low ? 0 : 1);
+    tm.driving = 0;
+}
+
+static void tmStart(avr_cycle_count_t now)
+{
+    if (!tm.inUpdate) {
+        tm.inUpdate = 1;
+        tm.updateStart = now;
+    }
+    tm.active = 1;
+    tm.bit = 0;
+    tm.bytes = 0;
+}
+
+static void tmStop(avr_cycle_count_t now)
+{
+    tm.active = 0;
+    tm.lastStop = now;
+    tm.transactions++;
+}
+
+static avr_cycle_count_t tmGap(struct avr_t *avr, avr_cycle_count_t when, void *param)
+{
+    (void)param;
+
+    if (tm.inUpdate && !tm.active &&
+        (when - tm.lastStop >= avr_usec_to_cycles(avr, TM_UPDATE_GAP_US))) {
+        statAdd(&tmUpdate, tm.lastStop - tm.updateStart);
+        tm.inUpdate = 0;
+    }
+
+    return when + avr_usec_to_cycles(avr, TM_UPDATE_GAP_US);
+}
+
+static void tmDio(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    uint8_t level = value ? 1 : 0;
+
+    (void)irq;
+    (void)param;
+
+    if (tm.driving) {
+        return;
+    }
+
+    if (tm.clk && (level != tm.dioLevel)) {
+        if (!level) {
+            tmStart(avr->cycle);
+        } else if (tm.active) {
+            tmStop(avr->cycle);
+        }
+    }
+    tm.dioLevel = level;
+}
+
+static void tmClk(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    uint8_t level = value ? 1 : 0;
+
+    (void)irq;
+    (void)param;
+
+    if (level && !tm.clk && tm.active) {
+        if (tm.bit < 8) {
+            tm.bit++;
+        } else {
+            tm.bit = 9;     // ACK clock
+        }
+    } else if (!level && tm.clk && tm.active) {
+        if (tm.bit == 8) {
+            tmAck(1);
+        } else if (tm.bit == 9) {
+            tmAck(0);
+            tm.bit = 0;
+            tm.bytes++;
+        }
+    }
+    tm.clk = level;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void uartByte(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    (void)irq;
+    (void)param;
+
+    uartBytes++;
+    if (uartOut) {
+        fputc((int)(value & 0xFF), uartOut);
+    }
+
+    if ((value & 0xFF) == 0) {
+        uartFrames++;
+        if (frameSampleAt) {
+            statAdd(&latency, avr->cycle - frameSampleAt);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "usage: %s [-t seconds] [-s script] [-n noise] [-o uart.bin] firmware.elf\n", prog);
+    exit(2);
+}
+
+/******************************************************************************/
+/*                                    Main                                    */
+/******************************************************************************/
+int main(int argc, char *argv[])
+{
+    elf_firmware_t fw;
+    double seconds = 10.0;
+    avr_cycle_count_t endCycle;
+    uint32_t flags = 0;
+    int status = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:s:n:o:")) != -1) {
+        switch (opt) {
+            case 't': seconds = atof(optarg); break;
+            case 'n': noise = atoi(optarg); break;
+            case 's':
+                if (loadScript(optarg)) {
+                    fprintf(stderr, "cannot read script %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'o':
+                uartOut = fopen(optarg, "wb");
+                if (!uartOut) {
+                    perror(optarg);
+                    return 1;
+                }
+                break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+    }
+
+    memset(&fw, 0, sizeof(fw));
+    if (elf_read_firmware(argv[optind], &fw) != 0) {
+        fprintf(stderr, "cannot load %s\n", argv[optind]);
+        return 1;
+    }
+    if (!fw.frequency) {
+        fw.frequency = SIM_FREQ;
+    }
+
+    avr = avr_make_mcu_by_name(fw.mmcu[0] ? fw.mmcu : SIM_MCU);
+    if (!avr) {
+        fprintf(stderr, "unknown MCU\n");
+        return 1;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &fw);
+
+    /* Region markers */
+    avr_register_io_write(avr, GPIOR0_ADDR, markWrite, NULL);
+
+    /* HX711: DOUT idles high until the first conversion */
+    hx.dout = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 6);
+    avr_raise_irq(hx.dout, 1);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 5), hxSck, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 7), hxRate, NULL);
+    avr_cycle_timer_register_usec(avr, HX_PERIOD_10SPS_US, hxConvert, NULL);
+
+    /* TM1637, DIO pulled up */
+    tm.dio = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 3);
+    tm.dioLevel = 1;
+    tmAck(0);
+    avr_irq_register_notify(tm.dio, tmDio, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 4), tmClk, NULL);
+    avr_cycle_timer_register_usec(avr, TM_UPDATE_GAP_US, tmGap, NULL);
+
+    /* Buttons released (pull-ups) */
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), 0), 1);
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 2), 1);
+
+    /* UART: bytes to the sink, not to stdout */
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), uartByte, NULL);
+
+    endCycle = (avr_cycle_count_t)(seconds * SIM_FREQ);
+    while (avr->cycle < endCycle) {
+        int state = avr_run(avr);
+
+        if ((state == cpu_Done) || (state == cpu_Crashed)) {
+            fprintf(stderr, "CPU stopped at cycle %llu\n", (unsigned long long)avr->cycle);
+            status = 1;
+            break;
+        }
+    }
+
+    printf("%.1f s simulated, %u UART bytes, %u frames, %u TM1637 transactions\n",
+           (double)avr->cycle / SIM_FREQ, uartBytes, uartFrames, tm.transactions);
+    printf("%-20s %8s %10s %10s %10s   (cycles)\n", "region", "count", "min", "mean", "max");
+    for (uint8_t i = 1; i < MARK_COUNT; i++) {
+        statPrint(&marks[i]);
+    }
+    statPrint(&tmUpdate);
+    statPrint(&latency);
+    if (!marks[MARK_XH17_READ].count) {
+        printf("no region markers seen, build the firmware with \"pio run -e sim\"\n");
+        status = 1;
+    }
+    if (!uartFrames) {
+        printf("no telemetry frames seen\n");
+        status = 1;
+    }
+    if (markErrors) {
+        printf("%u unbalanced markers\n", markErrors);
+        status = 1;
+    }
+
+    if (uartOut) {
+        fclose(uartOut);
+    }
+
+    return status;
+}
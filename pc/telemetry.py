@@ -0,0 +1,259 @@
+"""Decoder for the binary telemetry frames sent by telemetry_lib.
+
+Frames are COBS encoded and delimited by 0x00. After decoding:
+
+    [0]    version (high nibble) | frame type (low nibble)
+    [1]    sequence counter
+    [2..]  payload
+    [-2:]  CRC-16/CCITT-FALSE (little endian) over everything before it
+"""
+
+import struct
+from dataclasses import dataclass, field
+
+TLM_VERSION = 4     # 4: signed 32-bit raw and filtered
+
+TLM_TYPE_SAMPLES = 1
+TLM_TYPE_CAPTURE = 2
+TLM_TYPE_TRACE = 3
+TLM_TYPE_PROFILE = 4
+
+FLAG_STABLE = 0x01
+
+SAMPLE_SIZE = 19
+
+CAPTURE_HEADER_SIZE = 6
+CAPTURE_SAMPLE_SIZE = 8
+
+PROFILE_ENTRY_SIZE = 10
+# prof_lib.h profRegion_t order
+PROFILE_REGIONS = ["read", "filter", "format", "display", "uart"]
+
+
+def crc16_ccitt(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            if crc & 0x8000:
+                crc = ((crc << 1) ^ 0x1021) & 0xFFFF
+            else:
+                crc = (crc << 1) & 0xFFFF
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    n = len(data)
+    while i < n:
+        code = data[i]
+        if code == 0:
+            raise ValueError("zero byte inside COBS frame")
+        i += 1
+        end = i + code - 1
+        if end > n:
+            raise ValueError("truncated COBS block")
+        out += data[i:end]
+        i = end
+        if code != 0xFF and i < n:
+            out.append(0)
+    return bytes(out)
+
+
+def _varint(p, o):
+    v = shift = 0
+    while True:
+        if o >= len(p) or shift > 28:
+            raise ValueError("bad varint")
+        b = p[o]
+        o += 1
+        v |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            return v, o
+
+
+def parse_trace(block):
+    """Records of a trace_lib block as (timestamp_us, raw, tag) tuples.
+
+    raw is the conversion as read by xh17, offset binary (count ^ 0x800000),
+    the way src/replay takes it.
+    """
+    if not block:
+        return []
+    n = block[0]
+    o = 1
+    ts = 0
+    last = [0, 0, 0, 0]
+    out = []
+    for _ in range(n):
+        if o >= len(block) or block[o] & ~0x03:
+            raise ValueError("bad trace record")
+        tag = block[o]
+        dt, o = _varint(block, o + 1)
+        dv, o = _varint(block, o)
+        ts = (ts + dt) & 0xFFFFFFFF
+        raw = (last[tag] + ((dv >> 1) ^ -(dv & 1))) & 0xFFFFFFFF
+        last[tag] = raw - (1 << 32) if raw & 0x80000000 else raw
+        out.append((ts, last[tag], tag))
+    if o != len(block):
+        raise ValueError("trailing trace bytes")
+    return out
+
+
+@dataclass
+class Sample:
+    timestamp_us: int   # since start, 48 bits, doesn't wrap
+    raw: int            # signed counts, 0 at zero input
+    filtered: int
+    units: int
+    flags: int
+
+    @property
+    def stable(self):
+        return bool(self.flags & FLAG_STABLE)
+
+
+@dataclass
+class Capture:
+    id: int
+    trigger: int        # index of the trigger sample
+    peak: int           # index of the peak sample
+    samples: list       # (timestamp_us, raw), raw in signed counts
+
+    @property
+    def peak_sample(self):
+        return self.samples[self.peak]
+
+
+@dataclass
+class ProfileEntry:
+    name: str
+    count: int
+    min: int            # cycles
+    max: int
+    sum: int
+
+    @property
+    def mean(self):
+        return self.sum / self.count if self.count else 0.0
+
+
+@dataclass
+class Frame:
+    version: int
+    type: int
+    seq: int
+    payload: bytes
+    samples: list = field(default_factory=list)
+    chunk: dict = None          # TLM_TYPE_CAPTURE header fields
+    trace: list = None          # TLM_TYPE_TRACE records (timestamp_us, raw, tag)
+    profile: list = None        # TLM_TYPE_PROFILE ProfileEntry per region
+    overhead: int = 0           # cycles subtracted per profile sample
+    capture: Capture = None     # set on the frame completing a capture
+
+
+def parse_frame(body):
+    """Parse a COBS-decoded frame, raises ValueError on CRC/format errors."""
+    if len(body) < 4:
+        raise ValueError("short frame")
+    crc = struct.unpack_from("<H", body, len(body) - 2)[0]
+    if crc16_ccitt(body[:-2]) != crc:
+        raise ValueError("CRC mismatch")
+
+    frame = Frame(version=body[0] >> 4, type=body[0] & 0x0F, seq=body[1],
+                  payload=bytes(body[2:-2]))
+    if frame.version != TLM_VERSION:
+        raise ValueError(f"unsupported version {frame.version}")
+
+    if frame.type == TLM_TYPE_SAMPLES:
+        p = frame.payload
+        n = p[0]
+        if len(p) != 1 + n * SAMPLE_SIZE:
+            raise ValueError("bad sample count")
+        for i in range(n):
+            o = 1 + i * SAMPLE_SIZE
+            ts = int.from_bytes(p[o:o + 6], "little")
+            raw, filt, units = struct.unpack_from("<iii", p, o + 6)
+            frame.samples.append(Sample(ts, raw, filt, units, p[o + 18]))
+
+    elif frame.type == TLM_TYPE_CAPTURE:
+        p = frame.payload
+        if len(p) < CAPTURE_HEADER_SIZE:
+            raise ValueError("short capture frame")
+        cid, total, trig, peak, first, n = p[:CAPTURE_HEADER_SIZE]
+        if len(p) != CAPTURE_HEADER_SIZE + n * CAPTURE_SAMPLE_SIZE:
+            raise ValueError("bad capture sample count")
+        pts = []
+        for i in range(n):
+            o = CAPTURE_HEADER_SIZE + i * CAPTURE_SAMPLE_SIZE
+            pts.append(struct.unpack_from("<Ii", p, o))
+        frame.chunk = dict(id=cid, total=total, trigger=trig, peak=peak,
+                           first=first, samples=pts)
+
+    elif frame.type == TLM_TYPE_TRACE:
+        frame.trace = parse_trace(frame.payload)
+
+    elif frame.type == TLM_TYPE_PROFILE:
+        p = frame.payload
+        if len(p) < 2 or len(p) != 2 + p[0] * PROFILE_ENTRY_SIZE:
+            raise ValueError("bad profile frame")
+        frame.overhead = p[1]
+        frame.profile = []
+        for i in range(p[0]):
+            count, lo, hi, total = struct.unpack_from("<HHHI", p, 2 + i * PROFILE_ENTRY_SIZE)
+            name = PROFILE_REGIONS[i] if i < len(PROFILE_REGIONS) else f"region{i}"
+            frame.profile.append(ProfileEntry(name, count, lo, hi, total))
+
+    return frame
+
+
+class FrameDecoder:
+    """Incremental stream decoder: feed() raw bytes, get complete frames."""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.last_seq = None
+        self.frames_ok = 0
+        self.crc_errors = 0
+        self.seq_gaps = 0
+        self._capture = None
+
+    def _collect(self, frame):
+        c = frame.chunk
+        if c["first"] == 0:
+            self._capture = Capture(c["id"], c["trigger"], c["peak"], [])
+        cap = self._capture
+        if cap is None or cap.id != c["id"] or len(cap.samples) != c["first"]:
+            self._capture = None    # lost a chunk, wait for the next capture
+            return
+        cap.samples += c["samples"]
+        if len(cap.samples) == c["total"]:
+            frame.capture = cap
+            self._capture = None
+
+    def feed(self, data):
+        frames = []
+        self.buf += data
+        while True:
+            end = self.buf.find(b"\x00")
+            if end < 0:
+                break
+            chunk = bytes(self.buf[:end])
+            del self.buf[:end + 1]
+            if not chunk:
+                continue
+            try:
+                frame = parse_frame(cobs_decode(chunk))
+            except ValueError:
+                self.crc_errors += 1
+                continue
+
+            if self.last_seq is not None and frame.seq != (self.last_seq + 1) & 0xFF:
+                self.seq_gaps += (frame.seq - self.last_seq - 1) & 0xFF
+            self.last_seq = frame.seq
+            self.frames_ok += 1
+            if frame.chunk is not None:
+                self._collect(frame)
+            frames.append(frame)
+        return frames
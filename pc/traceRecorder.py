@@ -0,0 +1,64 @@
+"""Record a raw HX711 sample trace from the scales.
+
+Sends the trace command ("t;") to start streaming, stores every
+TLM_TYPE_TRACE block and sends it again to stop. The output file is the
+TRACE_FILE_MAGIC header followed by [length][block] entries, the format read
+by the replay tool (pio run -e replay).
+
+    python traceRecorder.py COM3 trace.bin --seconds 60
+"""
+
+import argparse
+import sys
+import time
+
+import serial
+
+from telemetry import FrameDecoder, TLM_TYPE_TRACE
+
+TRACE_FILE_MAGIC = b"HXTR\x01"
+CMD_TRACE = b"t;"
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("port")
+    ap.add_argument("output")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--seconds", type=float, default=30.0,
+                    help="recording length, Ctrl+C stops earlier")
+    args = ap.parse_args()
+
+    decoder = FrameDecoder()
+    blocks = records = 0
+    counts = [0, 0, 0, 0]
+
+    with serial.Serial(args.port, args.baud, timeout=0.1) as ser, \
+            open(args.output, "wb") as out:
+        out.write(TRACE_FILE_MAGIC)
+        ser.reset_input_buffer()
+        ser.write(CMD_TRACE)
+        end = time.monotonic() + args.seconds
+        try:
+            while time.monotonic() < end:
+                for frame in decoder.feed(ser.read(256)):
+                    if frame.type != TLM_TYPE_TRACE:
+                        continue
+                    out.write(bytes([len(frame.payload)]) + frame.payload)
+                    blocks += 1
+                    records += len(frame.trace)
+                    for _, _, tag in frame.trace:
+                        counts[tag] += 1
+        except KeyboardInterrupt:
+            pass
+        finally:
+            ser.write(CMD_TRACE)
+
+    print(f"{records} samples in {blocks} blocks "
+          f"(A128 {counts[0]}, B32 {counts[1]}, A64 {counts[2]}, A64 ref {counts[3]}), "
+          f"{decoder.seq_gaps} frames lost, {decoder.crc_errors} CRC errors",
+          file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
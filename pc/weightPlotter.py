@@ -8,6 +8,8 @@ matplotlib.use("TkAgg")
 from matplotlib.backends.backend_tkagg import FigureCanvasTkAgg
 from matplotlib.figure import Figure
 
+from telemetry import FrameDecoder
+
 
 class UartPlotApp(tk.Tk):
     def __init__(self):
@@ -17,7 +19,8 @@ class UartPlotApp(tk.Tk):
 
         # Serial state
         self.ser = None
-        self.rx_buf = ""
+        self.decoder = FrameDecoder()
+        self.capture_info = ""
 
         # Data for plot
         self.x = []
@@ -135,7 +138,7 @@ class UartPlotApp(tk.Tk):
 
         try:
             self.ser = serial.Serial(port, baudrate=baud, timeout=0)
-            self.rx_buf = ""
+            self.decoder = FrameDecoder()
             self.status_var.set(f"Connected: {port} @ {baud}")
             self.connect_btn.config(text="Disconnect")
             self.after(20, self.poll_uart)
@@ -174,9 +177,8 @@ class UartPlotApp(tk.Tk):
         try:
             n = self.ser.in_waiting
             if n:
-                chunk = self.ser.read(n).decode("utf-8", errors="ignore")
-                self.rx_buf += chunk
-                if self._consume_values():
+                chunk = self.ser.read(n)
+                if self._consume_values(self.decoder.feed(chunk)):
                     self._update_plot()
         except Exception as e:
             self.disconnect()
@@ -185,19 +187,29 @@ class UartPlotApp(tk.Tk):
 
         self.after(20, self.poll_uart)
 
-    def _consume_values(self):
+    def _consume_values(self, frames):
         updated = False
-        parts = self.rx_buf.split(";")
-        self.rx_buf = parts[-1]
-
-        for token in parts[:-1]:
-            token = token.strip()
-            if not token:
-                continue
-            try:
-                grams = float(token)
-            except ValueError:
-                continue
+        samples = [smp for fr in frames for smp in fr.samples]
+
+        for fr in frames:
+            if fr.capture is not None:
+                cap = fr.capture
+                t0 = cap.samples[cap.trigger][0]
+                t, raw = cap.peak_sample
+                self.capture_info = (
+                    f"  capture #{cap.id}: peak {raw} counts "
+                    f"at {(t - t0) / 1000.0:+.1f} ms"
+                )
+
+        if frames:
+            d = self.decoder
+            self.status_var.set(
+                f"Connected: {self.ser.port}  frames {d.frames_ok}  "
+                f"crc err {d.crc_errors}  lost {d.seq_gaps}{self.capture_info}"
+            )
+
+        for smp in samples:
+            grams = float(smp.units)
 
             # plot data (grams)
             self.x.append(self.sample_idx)
@@ -207,7 +219,8 @@ class UartPlotApp(tk.Tk):
 
             # LAST
             self.last_value_g = grams
-            self.last_value_var.set(f"{grams / 1000.0:.2f} kg")
+            mark = "" if smp.stable else " ~"
+            self.last_value_var.set(f"{grams / 1000.0:.2f} kg{mark}")
 
             # MAX
             if self.max_value_g is None or grams > self.max_value_g:
@@ -1,77 +1,499 @@
-#include <avr/io.h>
-#include <avr/eeprom.h>
-#include <util/delay.h>
+#include "hal_lib.h"
 
 #include <stdint.h>
 #include <stdlib.h>
+#if defined(SIM_FMT_REF)
+#include <stdio.h>
+#endif
 
 #include "xh17_lib.h"
 #include "tm1637_lib.h"
 #include "usart_lib.h"
 #include "millis_lib.h"
+#include "time_lib.h"
 #include "button_lib.h"
+#include "telemetry_lib.h"
+#include "fmt_lib.h"
+#include "sched_lib.h"
+#include "calstore_lib.h"
+#include "stable_lib.h"
+#include "capture_lib.h"
+#include "calproc_lib.h"
+#include "trace_lib.h"
+#include "prof_lib.h"
+#include "scales_config.h"
 
 #define CALIBRATION_WEIGHT 1000
 
+/* Burst capture, armed by a long press of tare: trigger distance from zero,
+samples kept before the trigger and how long the display shows the peak */
+#define CAPTURE_TRIGGER_COUNTS 40000
+#define CAPTURE_PRE_SAMPLES    8
+#define CAPTURE_PEAK_SHOW_MS   3000
 
-XH17_DECLARE_CTXT(scaler, PORTD, 5, PORTD, 6);
+/* Averaged tare / span: samples, allowed spread (counts), timeout and how
+long an error stays on the display */
+#define CALPROC_SAMPLES        16
+#define CALPROC_MAX_SPREAD     STABLE_BAND_COUNTS
+#define CALPROC_TIMEOUT_MS     4000
+#define CALPROC_ERR_SHOW_MS    1500
+
+enum {
+    proc_tare = 0,
+    proc_span
+};
+
+/* 1: telemetry carries only settled values and the stable/motion edges */
+#define TLM_SETTLED_ONLY   1
+
+/* Commands from the host: one letter terminated by ';', e.g. "t;" */
+#define CMD_TRACE          't'  // start/stop streaming raw HX711 samples
+#define CMD_PROFILE        'p'  // send and clear the cycle profile (prof_lib)
+
+#if TRACE_BLOCK_MAX > TLM_PAYLOAD_MAX
+#error "A trace block must fit into one telemetry frame"
+#endif
+
+
+XH17_DECLARE_CTXT_RATE(scaler, PORTD, 5, PORTD, 6, PORTD, 7);
 TM16_DECLARE_CTXT(disp, PORTD, 4, PORTD, 3, 4);
 BUTTON_DECLARE_CTXT(buttonTare, PORTB, 0, 0, 1);
 BUTTON_DECLARE_CTXT(buttonScale, PORTD, 2, 0, 1);
+TLM_DECLARE_CTXT(telemetry, 2);
+STABLE_DECLARE_CTXT(stability, STABLE_BAND_COUNTS, STABLE_LEAVE_COUNTS, STABLE_HOLD_MS);
+CAPTURE_DECLARE_CTXT(burst);
+CALPROC_DECLARE_CTXT(proc);
+
+/* Used when EEPROM holds no valid calibration record */
+static const calRecord_t calDefaults = {
+    .offset = 0,
+    .spanCounts = 1,
+    .spanUnits = 1,
+    .points = 0,
+    .dLow = XH17_D_LOW_DEFAULT,
+    .dHigh = XH17_D_HIGH_DEFAULT,
+    .alphaMin_q8 = XH17_ALPHA_MIN_Q8_DEFAULT,
+    .alphaMax_q8 = XH17_ALPHA_MAX_Q8_DEFAULT,
+    .outDeadBand = XH17_OUT_DEAD_BAND_DEFAULT,
+    .inputSelect = xh17_inputSelect_A_128,
+    .autoRange = 1
+};
 
-uint8_t EEMEM scaleVal = 1;
+static calRecord_t calRec;
+
+ISR(PCINT2_vect)
+{
+    // The rising DOUT edge reads nothing, keep it out of the profile
+    if (xh17_isReady(&scaler)) {
+        PROF_BEGIN(prof_region_read);
+        scaler_irqHandler();
+        PROF_END(prof_region_read);
+    }
+}
+
+ISR(TIMER2_COMPA_vect)
+{
+    disp_tick();
+}
+
+static int32_t weight = 0;
+static int32_t lastFiltered = 0;
+static uint32_t peakShowStart = 0;
+static uint8_t peakShow = 0;
+static uint32_t procErrStart = 0;
+static uint8_t procErr = 0;
+
+/* Raw sample trace (CMD_TRACE), sent as TLM_TYPE_TRACE frames */
+static traceCtxt_t trace;
+static uint8_t traceOn = 0;
+
+/* Profile dump requested (CMD_PROFILE), retried until the UART has room */
+static uint8_t profDump = 0;
+
+static void applyCalibration(const calRecord_t *rec)
+{
+    xh17_setOffset(&scaler, rec->offset);
+    xh17_setSpan(&scaler, rec->spanCounts, rec->spanUnits);
+    calib_setPoints(&scaler.cal, rec->pt, rec->points);
+    xh17_setFilterParams(&scaler, rec->dLow, rec->dHigh,
+                         rec->alphaMin_q8, rec->alphaMax_q8, rec->outDeadBand);
+    xh17_setInputSelect(&scaler, (xh17_inputSelect_t)rec->inputSelect);
+    xh17_setAutoRange(&scaler, rec->autoRange);
+}
+
+static void startProc(uint8_t tag)
+{
+    calproc_start(&proc, tag, CALPROC_SAMPLES, CALPROC_MAX_SPREAD,
+                  CALPROC_TIMEOUT_MS, millis());
+}
+
+/* Apply a finished tare / span procedure, or flag its failure */
+static void finishProc(calprocStatus_t status)
+{
+    if (status == calproc_status_done) {
+        int32_t result = calproc_getResult(&proc);
+
+        if (calproc_getTag(&proc) == proc_tare) {
+            xh17_setOffset(&scaler, (uint32_t)result);
+            // Empty platform: measure where gain 64 puts this zero
+            xh17_calibrateRange(&scaler);
+        } else {
+            calRec.offset = scaler.offset;
+            calRec.spanCounts = result - (int32_t)scaler.offset;
+            calRec.spanUnits = CALIBRATION_WEIGHT;
+            xh17_setSpan(&scaler, calRec.spanCounts, calRec.spanUnits);
+            // Written by taskCalstore, a byte per tick: a blocking save
+            // would overflow the sample ring
+            calstore_saveStart(&calRec);
+        }
+    } else {
+        procErrStart = millis();
+        procErr = 1;
+    }
+
+    calproc_finish(&proc);
+}
+
+/* 80 SPS while the load moves or a capture runs, 10 SPS (less noise) at rest.
+xh17_setRate() rescales the filter and drops the settling conversions. */
+static void updateRate(bool stable)
+{
+    captureState_t cs = capture_getState(&burst);
+    bool fast = (cs == capture_state_armed) || (cs == capture_state_triggered) ||
+                (ADAPTIVE_RATE && !stable);
+    xh17_rate_t rate = fast ? xh17_rate_80SPS : xh17_rate_10SPS;
+
+    // xh17_setRate() is true for an unchanged rate too
+    if ((rate != scaler.rate) && xh17_setRate(&scaler, rate)) {
+        if (fast) {
+            stable_setBand(&stability, STABLE_BAND_COUNTS_80SPS, STABLE_LEAVE_COUNTS_80SPS);
+        } else {
+            stable_setBand(&stability, STABLE_BAND_COUNTS, STABLE_LEAVE_COUNTS);
+        }
+        // The window holds the other rate's noise, the state stays
+        stable_restart(&stability);
+    }
+}
+
+/* Send the trace block built so far and start the next one */
+static void traceFlush(void)
+{
+    if (trace_count(&trace)) {
+        tlm_sendFrame(&telemetry, TLM_TYPE_TRACE, trace.block, trace.len);
+    }
+    trace_reset(&trace);
+}
+
+static void traceSample(const xh17Sample_t *s, uint32_t timestamp)
+{
+    if (!trace_add(&trace, timestamp, s->raw, s->sel)) {
+        traceFlush();
+        trace_add(&trace, timestamp, s->raw, s->sel);
+    }
+}
+
+/* Drain the HX711 ring: filter, convert and queue every sample */
+#if defined(SIM_GPIO_REF)
+/* Pin set + clear on PB5 (D13) through the three paths of the gpio_lib.h
+table, each pair marked for the simavr harness */
+#define SIM_GPIO_LOOPS 16
+
+GPIO_DECLARE_PIN(simPin, PORTB, 5)
+
+// Arduino core, wiring_digital.c
+void digitalWrite(uint8_t pin, uint8_t val);
+
+typedef struct {
+    volatile uint8_t *port;
+    uint8_t bit;
+} simPtrPin_t;
+
+static simPtrPin_t simPtrPin = { &PORTB, 5 };
+
+/* The old drivers' accessors: a call with the pin resolved at run time */
+static void __attribute__((noinline, noclone)) simPtrHigh(simPtrPin_t *me)
+{
+    *me->port |= (1 << me->bit);
+}
+
+static void __attribute__((noinline, noclone)) simPtrLow(simPtrPin_t *me)
+{
+    *me->port &= ~(1 << me->bit);
+}
+
+static void simGpioRef(void)
+{
+    simPin_setOutput();
+
+    for (uint8_t i = 0; i < SIM_GPIO_LOOPS; i++) {
+        HAL_MARK(HAL_MARK_GPIO_INLINE);
+        simPin_setHigh();
+        simPin_setLow();
+        HAL_MARK(HAL_MARK_GPIO_INLINE | HAL_MARK_END);
+
+        HAL_MARK(HAL_MARK_GPIO_PTR);
+        simPtrHigh(&simPtrPin);
+        simPtrLow(&simPtrPin);
+        HAL_MARK(HAL_MARK_GPIO_PTR | HAL_MARK_END);
+
+        HAL_MARK(HAL_MARK_GPIO_ARDUINO);
+        digitalWrite(13, 1);
+        digitalWrite(13, 0);
+        HAL_MARK(HAL_MARK_GPIO_ARDUINO | HAL_MARK_END);
+    }
+}
+#endif
+
+static void taskSample(void)
+{
+    static uint8_t wasStable = 0;
+    static int32_t lastSent = 0;
+    xh17Sample_t s;
+    int32_t raw;
+
+    // A stalled sensor must still end a running procedure
+    if (calproc_poll(&proc, millis()) == calproc_status_timeout) {
+        finishProc(calproc_status_timeout);
+    }
+
+    while (xh17_popSample(&scaler, &s)) {
+        tlmSample_t sample;
+
+        // Stamped in the ISR at the ready edge. The trace keeps every
+        // conversion as read, channel B included. It and the capture store
+        // the low 32 bits, their deltas survive a wrap.
+        sample.timestamp = time_ticksToUs(time_extend(s.ticks));
+        if (traceOn) {
+            traceSample(&s, (uint32_t)sample.timestamp);
+        }
+
+        if (!xh17_sampleToRaw(&scaler, &s, &raw)) {
+            continue;
+        }
+
+        // Hold time on the conversion time: a backlog drained late after a
+        // slow task must not shorten or stretch it. 32-bit ms like millis().
+        bool stable = stable_update(&stability, raw, (uint32_t)(sample.timestamp / 1000));
+
+        sample.raw = raw;
+        PROF_BEGIN(prof_region_filter);
+        sample.filtered = xh17_filter(&scaler, raw);
+        PROF_END(prof_region_filter);
+        lastFiltered = sample.filtered;
+        xh17_zeroTrack(&scaler, sample.filtered, stable);
+        sample.units = xh17_toUnits(&scaler, sample.filtered);
+        sample.flags = stable ? TLM_FLAG_STABLE : 0;
+
+        calprocStatus_t status = calproc_add(&proc, raw, millis());
+
+        if ((status != calproc_status_idle) && (status != calproc_status_running)) {
+            finishProc(status);
+        }
+
+        if (capture_add(&burst, (uint32_t)sample.timestamp, raw)) {
+            weight = xh17_toUnits(&scaler, capture_getPeak(&burst)->raw);
+            peakShowStart = millis();
+            peakShow = 1;
+        }
+
+        updateRate(stable);
+
+        if (!TLM_SETTLED_ONLY || (stable != wasStable) ||
+            (stable && (sample.units != lastSent))) {
+            PROF_BEGIN(prof_region_uart);
+            tlm_addSample(&telemetry, &sample);
+            PROF_END(prof_region_uart);
+            lastSent = sample.units;
+        }
+
+        wasStable = stable;
+
+        if (peakShow && (millis() - peakShowStart < CAPTURE_PEAK_SHOW_MS)) {
+            continue;
+        }
+        peakShow = 0;
+        // Settled values only, the display holds the last one while moving
+        if (stable) {
+            weight = sample.units;
+        }
+    }
+}
+
+/* Each action fires once per press, holding a button no longer repeats it */
+static void taskButtons(void)
+{
+    button_tick(&buttonTare);
+    button_tick(&buttonScale);
+
+    buttonEvent_t tareEvent = button_getEvent(&buttonTare);
+
+    if (tareEvent == button_event_press) {
+        startProc(proc_tare);
+    }
+
+    // Hold tare: zero (started on press) and arm an 80 SPS burst capture.
+    // The tare started on the press has not finished yet, so scaler.offset
+    // is still the old zero: trigger on a change from the present load.
+    if ((tareEvent == button_event_longPress) &&
+        xh17_setRate(&scaler, xh17_rate_80SPS)) {
+        capture_arm(&burst, lastFiltered, CAPTURE_TRIGGER_COUNTS, CAPTURE_PRE_SAMPLES);
+    }
+
+    // Calibration writes EEPROM, require a deliberate long press
+    if (button_getEvent(&buttonScale) == button_event_longPress) {
+        startProc(proc_span);
+    }
+}
+
+static void taskDisplay(void)
+{
+    char buffer[FMT_FIXED_BUF_SIZE];
+
+    if (calproc_poll(&proc, millis()) == calproc_status_running) {
+        // "t 50" / "C 50": tare or span, percent of samples collected
+        buffer[0] = (calproc_getTag(&proc) == proc_tare) ? 't' : 'C';
+        fmt_fixed(&buffer[1], calproc_progress(&proc), 0, 0, 3, '\0');
+        if (buffer[1] == '0') {
+            buffer[1] = ' ';
+            if (buffer[2] == '0') {
+                buffer[2] = ' ';
+            }
+        }
+        tm1637_print(&disp, buffer);
+        return;
+    }
+
+    if (procErr && (millis() - procErrStart < CALPROC_ERR_SHOW_MS)) {
+        tm1637_print(&disp, "Err");
+        return;
+    }
+    procErr = 0;
+
+    // grams -> "kkgg" (kg and 1/100 kg, the display has no DP)
+    PROF_BEGIN(prof_region_format);
+    HAL_MARK(HAL_MARK_FMT);
+    fmt_fixed(buffer, weight, 3, 2, 2, '\0');
+    HAL_MARK(HAL_MARK_FMT | HAL_MARK_END);
+    PROF_END(prof_region_format);
+
+#if defined(SIM_FMT_REF)
+    {
+        // Same digits the printf way, only timed: buffer is not touched
+        static char ref[FMT_FIXED_BUF_SIZE];
+        int32_t g = (weight < 0) ? -weight : weight;
+
+        HAL_MARK(HAL_MARK_FMT_REF);
+        snprintf(ref, sizeof(ref), "%s%02ld%02ld", (weight <= -10) ? "-" : "",
+                 (long)(g / 1000), (long)((g % 1000) / 10));
+        HAL_MARK(HAL_MARK_FMT_REF | HAL_MARK_END);
+    }
+#endif
+
+    PROF_BEGIN(prof_region_display);
+    tm1637_print(&disp, buffer);
+    PROF_END(prof_region_display);
+}
+
+/* Send a completed capture, one frame per run as the UART queue drains */
+static void taskCapture(void)
+{
+    capture_dump(&burst, &telemetry);
+}
+
+/* Bound the latency of a partially filled telemetry batch */
+static void taskTelemetry(void)
+{
+    tlm_flush(&telemetry);
+
+    if (traceOn) {
+        traceFlush();
+    }
+}
+
+/* Write a queued calibration record to EEPROM, one byte at a time */
+static void taskCalstore(void)
+{
+    calstore_saveStep();
+}
+
+/* Handle a command line received on the UART, see CMD_* */
+static void taskCommand(void)
+{
+    char cmd[USART0_BUFFER_SIZE];
+
+    if (profDump && prof_dump(&telemetry)) {
+        profDump = 0;
+    }
+
+    if (USART0_GetStatus() != RECEIVED_OK) {
+        return;
+    }
+    USART0_ReadBuffer(cmd);
+    USART0_DataWasRead();
+
+    switch (cmd[0]) {
+        case CMD_TRACE:
+            if (traceOn) {
+                traceFlush();
+            } else {
+                trace_reset(&trace);
+            }
+            traceOn = !traceOn;
+            break;
+
+        case CMD_PROFILE:
+            profDump = 1;
+            break;
+
+        default:
+            break;
+    }
+}
+
+static schedTask_t tasks[] = {
+    SCHED_TASK(taskSample,    0,                 0, 500),
+    SCHED_TASK(taskButtons,   BUTTON_TICK_MS,    2, 1000),
+    SCHED_TASK(taskDisplay,   TASK_DISPLAY_MS,   1, 1000),
+    SCHED_TASK(taskTelemetry, TASK_TELEMETRY_MS, 1, 500),
+    SCHED_TASK(taskCapture,   TASK_CAPTURE_MS,   1, 500),
+    SCHED_TASK(taskCommand,   TASK_COMMAND_MS,   1, 200),
+    SCHED_TASK(taskCalstore,  TASK_CALSTORE_MS,  1, 200),
+};
 
 int main(void) {
+#if defined(SIM_GPIO_REF)
+    simGpioRef();
+#endif
     USART0_init();
-    millis_init();
+    time_init();
+    prof_init();
 
     tm1637_initHw(&disp);
     tm1637_setBrightness(&disp, 2);
+    tm1637_asyncInit(&disp, NULL);
 
     xh17_initHw(&scaler);
-    xh17_setInputSelect(&scaler, xh17_inputSelect_A_64);
-    xh17_tare(&scaler);
-    scaler.scale = eeprom_read_byte(&scaleVal);
-    xh17_setScale(&scaler, scaler.scale);
+    if (!calstore_load(&calRec)) {
+        calRec = calDefaults;
+    }
+    applyCalibration(&calRec);
+    xh17_setZeroTracking(&scaler, AZT_BAND_COUNTS, AZT_STEP_COUNTS);
+    xh17_startAsync(&scaler);
 
     button_initHw(&buttonTare);
     button_initHw(&buttonScale);
-    
-    int16_t weight, prevWeight = 0;
 
     tm1637_print(&disp, "v01");
     _delay_ms(2000);
     tm1637_print(&disp, "0000");
 
-    while (1) {
-
-        if (button_isPressed(&buttonTare)) {
-            xh17_tare(&scaler);
-        }
-
-        if (button_isPressed(&buttonScale)) {
-            uint32_t load = xh17_readFiltered(&scaler);
-
-            scaler.scale = (load - scaler.offset) / CALIBRATION_WEIGHT;
-            xh17_setScale(&scaler, scaler.scale);
-            eeprom_write_byte(&scaleVal, scaler.scale);
-        }
-
-        if (xh17_isReady(&scaler)) {
-            char buffer[32];
-            // int16_t raw = xh17_readRawUnits(&scaler);
+    startProc(proc_tare);
+    stable_reset(&stability, millis());
 
-            weight = xh17_readFilteredUnits(&scaler);
-            if (weight != prevWeight) {
-                snprintf(buffer, sizeof(buffer), "%d;", (weight/10)*10);
-                USART0_SendData(buffer);
+    sched_init(tasks, SCHED_TASK_COUNT(tasks));
 
-                snprintf(buffer, sizeof(buffer), "%02d%02d", weight/1000, (weight%1000)/10);
-                tm1637_print(&disp, buffer);
-
-                prevWeight = weight;
-            }
-        }
+    while (1) {
+        sched_run(tasks, SCHED_TASK_COUNT(tasks));
     }
 
     return 0;
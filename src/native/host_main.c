@@ -0,0 +1,1165 @@
+/*
+ * Host program of the PlatformIO "native" env.
+ *
+ * Runs the drivers against the register model of hal_lib: an HX711 and a
+ * TM1637 are emulated behind the PORTD hook, the buttons, the UART and the
+ * Timer0 time base are driven through their registers and ISRs, and the task
+ * table of src/main.c runs on simulated time. Then the fixed-point hot paths
+ * are timed on the host CPU; the numbers are for comparing builds against
+ * each other, not AVR cycle counts.
+ *
+ * Exit status is the number of failed checks.
+ */
+#include "hal_lib.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "xh17_lib.h"
+#include "tm1637_lib.h"
+#include "usart_lib.h"
+#include "button_lib.h"
+#include "telemetry_lib.h"
+#include "filter_lib.h"
+#include "calib_lib.h"
+#include "fmt_lib.h"
+#include "time_lib.h"
+#include "sched_lib.h"
+#include "stable_lib.h"
+#include "calstore_lib.h"
+#include "scales_config.h"
+
+/******************************************************************************/
+/*                             Internal definitions                           */
+/******************************************************************************/
+
+/* Same wiring as src/main.c */
+#define HX_SCK_BIT      5
+#define HX_DOUT_BIT     6
+#define TM_CLK_BIT      4
+#define TM_DIO_BIT      3
+
+/* Group of four HX711: shared PD_SCK on PB1, DOUTs on PC0..PC3 */
+#define GRP_SCK_BIT     1
+#define GRP_DOUT_BITS   0x0F
+#define GRP_CHANNELS    4
+
+#define TM_LOG_SIZE     64
+#define UART_LOG_SIZE   128
+
+#define BENCH_LOOPS     2000000UL
+
+XH17_DECLARE_CTXT(scaler, PORTD, HX_SCK_BIT, PORTD, HX_DOUT_BIT);
+TM16_DECLARE_CTXT(disp, PORTD, TM_CLK_BIT, PORTD, TM_DIO_BIT, 4);
+BUTTON_DECLARE_CTXT(buttonTare, PORTB, 0, 0, 1);
+TLM_DECLARE_CTXT(telemetry, 1);
+XH17_DECLARE_GROUP(cells, PORTB, GRP_SCK_BIT, PORTC, GRP_DOUT_BITS);
+XH17_DECLARE_CTXT(drifter, PORTB, 4, PORTB, 5);
+STABLE_DECLARE_CTXT(stability, STABLE_BAND_COUNTS_80SPS, STABLE_LEAVE_COUNTS_80SPS,
+                    STABLE_HOLD_MS);
+
+/* HX711 model: DOUT low while a conversion is ready, one data bit per PD_SCK
+rising edge MSB first, busy again after the 25th edge */
+static struct {
+    int32_t value;
+    uint8_t pulses;
+    uint8_t lastPulses;
+    uint8_t dout;
+    uint8_t sck;
+} hx;
+
+/* Adaptive rate loop of taskSample(), on simulated time */
+static struct {
+    uint32_t nowMs;
+    uint8_t fast;
+    uint16_t switches;
+    uint32_t lcg;
+} rate;
+
+/* Synthetic drift trace: 10 SPS, zero creeping by creep counts over the
+run, a load on top and uniform noise of the given peak-to-peak */
+static struct {
+    uint32_t nowMs;
+    uint32_t lcg;
+    int32_t maxStep;    // largest aztDrift change in one sample
+} drift;
+
+/* HX711 group model: one value per chip, all clocked by the shared PD_SCK */
+static struct {
+    int32_t value[GRP_CHANNELS];
+    uint8_t pulses;
+    uint8_t sck;
+} grp;
+
+/* TM1637 model: decodes start/stop and LSB first bytes, pulls DIO low for
+the ACK clock. Transactions are logged as [length, bytes...]. */
+static struct {
+    uint8_t clk;
+    uint8_t dio;
+    uint8_t ackLow;
+    uint8_t bit;
+    uint8_t byte;
+    uint8_t active;
+    uint8_t start;      // log index of the running transaction
+    uint8_t logLen;
+    uint8_t log[TM_LOG_SIZE];
+} tm;
+
+static uint8_t uartLog[UART_LOG_SIZE];
+static uint8_t uartLen;
+
+static uint8_t failures;
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+static void check(int ok, const char *what)
+{
+    printf("%-48s %s\n", what, ok ? "ok" : "FAIL");
+
+    if (!ok) {
+        failures++;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void hxEdge(void)
+{
+    uint8_t sck = (PORTD >> HX_SCK_BIT) & 1;
+
+    if (sck && !hx.sck) {
+        hx.pulses++;
+        if (hx.pulses <= 24) {
+            hx.dout = (hx.value >> (24 - hx.pulses)) & 1;
+        } else {
+            hx.dout = 1;
+        }
+    }
+    hx.sck = sck;
+}
+
+static void hxConvert(int32_t value)
+{
+    hx.lastPulses = hx.pulses;
+    hx.pulses = 0;
+    hx.value = value & 0xFFFFFFL;
+    hx.dout = 0;
+    PIND = (PIND & ~(1 << HX_DOUT_BIT)) | (hx.dout << HX_DOUT_BIT);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void grpEdge(void)
+{
+    uint8_t sck = (PORTB >> GRP_SCK_BIT) & 1;
+
+    if (sck && !grp.sck) {
+        grp.pulses++;
+        for (uint8_t ch = 0; ch < GRP_CHANNELS; ch++) {
+            uint8_t dout = (grp.pulses <= 24) ? (grp.value[ch] >> (24 - grp.pulses)) & 1 : 1;
+
+            PINC = (PINC & ~(1 << ch)) | (dout << ch);
+        }
+    }
+    grp.sck = sck;
+}
+
+static void grpConvert(const int32_t *values)
+{
+    grp.pulses = 0;
+    for (uint8_t ch = 0; ch < GRP_CHANNELS; ch++) {
+        grp.value[ch] = values[ch] & 0xFFFFFFL;
+    }
+    PINC &= ~GRP_DOUT_BITS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void tmPut(uint8_t b)
+{
+    if (tm.logLen < TM_LOG_SIZE) {
+        tm.log[tm.logLen++] = b;
+    }
+}
+
+static void tmEdge(void)
+{
+    uint8_t clk = (PORTD >> TM_CLK_BIT) & 1;
+    uint8_t dio;
+
+    if (DDRD & (1 << TM_DIO_BIT)) {
+        dio = (PORTD >> TM_DIO_BIT) & 1;
+    } else {
+        dio = !tm.ackLow;   // released, pull-up
+    }
+
+    if (clk && tm.clk && (dio != tm.dio)) {
+        if (!dio) {
+            /* Start: open a new log entry */
+            tm.active = 1;
+            tm.bit = 0;
+            tm.start = tm.logLen;
+            tmPut(0);
+        } else if (tm.active) {
+            /* Stop: close it */
+            tm.active = 0;
+            tm.log[tm.start] = tm.logLen - tm.start - 1;
+        }
+    } else if (clk && !tm.clk && tm.active) {
+        if (tm.bit < 8) {
+            tm.byte = (tm.byte >> 1) | (dio << 7);
+            if (++tm.bit == 8) {
+                tmPut(tm.byte);
+            }
+        } else {
+            tm.bit = 9;     // ACK clock
+        }
+    } else if (!clk && tm.clk) {
+        if (tm.bit == 8) {
+            tm.ackLow = 1;
+        } else if (tm.bit == 9) {
+            tm.ackLow = 0;
+            tm.bit = 0;
+        }
+        if (!(DDRD & (1 << TM_DIO_BIT))) {
+            dio = !tm.ackLow;
+        }
+    }
+
+    tm.clk = clk;
+    tm.dio = dio;
+    PIND = (PIND & ~(1 << TM_DIO_BIT)) | (dio << TM_DIO_BIT);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void portHook(volatile uint8_t *reg)
+{
+    if ((reg == &PORTD) || (reg == &DDRD)) {
+        hxEdge();
+        tmEdge();
+        PIND = (PIND & ~(1 << HX_DOUT_BIT)) | (hx.dout << HX_DOUT_BIT);
+    } else if (reg == &PORTB) {
+        grpEdge();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* Run the UDRE interrupt until the queue is empty, the ISR leaves UDRIE0 set
+after each byte it moved to UDR0 */
+static void uartDrain(void)
+{
+    while (UCSR0B & (1 << UDRIE0)) {
+        HAL_ISR_CALL(USART_UDRE_vect);
+        if ((UCSR0B & (1 << UDRIE0)) && (uartLen < UART_LOG_SIZE)) {
+            uartLog[uartLen++] = UDR0;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void testXh17(void)
+{
+    static const int32_t values[] = { 0, 1, -1, 0x7FFFFF, -0x800000, 123456, -654321 };
+    uint8_t ok = 1;
+    uint64_t t0;
+
+    hxConvert(0);
+    xh17_initHw(&scaler);
+
+    for (uint8_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        hxConvert(values[i]);
+        if (xh17_readRaw(&scaler) != ((values[i] & 0xFFFFFFL) ^ 0x800000L)) {
+            ok = 0;
+        }
+    }
+    check(ok, "xh17: 24-bit shift-in");
+
+    hxConvert(0);
+    check(hx.lastPulses == 25, "xh17: channel A gain 128 uses 25 pulses");
+
+    xh17_setInputSelect(&scaler, xh17_inputSelect_B_32);
+    hxConvert(0);
+    (void)xh17_readRaw(&scaler);
+    hxConvert(0);
+    check(hx.lastPulses == 26, "xh17: channel B gain 32 uses 26 pulses");
+
+    xh17_setInputSelect(&scaler, xh17_inputSelect_A_64);
+    hxConvert(0);
+    t0 = hal_native_timeNs();
+    (void)xh17_readRaw(&scaler);
+    printf("  PD_SCK time per read: %lu ns\n", (unsigned long)(hal_native_timeNs() - t0));
+    hxConvert(0);
+    check(hx.lastPulses == 27, "xh17: channel A gain 64 uses 27 pulses");
+
+    xh17_setInputSelect(&scaler, xh17_inputSelect_A_128);
+}
+
+/* Interrupt-driven reads, through the generated scaler_irqHandler() and
+through the pin table */
+static void testXh17Async(void)
+{
+    static const int32_t values[] = { 0, 1, -1, 0x7FFFFF, -0x800000, 123456 };
+    xh17Sample_t s;
+    uint8_t ok = 1;
+    uint8_t okTable = 1;
+
+    xh17_startAsync(&scaler);
+
+    for (uint8_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        int32_t expect = (values[i] & 0xFFFFFFL) ^ 0x800000L;
+
+        hxConvert(values[i]);
+        scaler_irqHandler();
+        if (!xh17_popSample(&scaler, &s) || (s.raw != expect) ||
+            (s.sel != xh17_inputSelect_A_128) || (hx.pulses != 25)) {
+            ok = 0;
+        }
+
+        hxConvert(values[i]);
+        xh17_irqHandler(&scaler);
+        if (!xh17_popSample(&scaler, &s) || (s.raw != expect) || (hx.pulses != 25)) {
+            okTable = 0;
+        }
+    }
+    check(ok, "xh17: async read, scaler_irqHandler()");
+    check(okTable, "xh17: async read, pin table");
+
+    TCNT0 = 77;
+    hxConvert(0);
+    scaler_irqHandler();
+    TCNT0 = 200;    // consumer runs later
+    check(xh17_popSample(&scaler, &s) &&
+          (s.ticks == time_ticks32() - 123),
+          "xh17: sample stamped at the ready edge");
+
+    // DOUT high again after the read: the rising edge reads nothing
+    scaler_irqHandler();
+    check(xh17_available(&scaler) == 0, "xh17: busy DOUT ignored");
+
+    xh17_stopAsync(&scaler);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* Gain 64 zero reference: the model's offsets don't scale with the gain
+(offset64 != offset128 / 2), as on a real HX711 */
+#define RANGE_OFF128    300000L
+#define RANGE_OFF64     120000L
+#define RANGE_LOAD      0x500000L
+
+/* Signed count the model converts, and the raw value read from it */
+static int32_t rangeCount(uint8_t sel, int32_t load)
+{
+    return (sel == xh17_inputSelect_A_128) ? RANGE_OFF128 + load
+                                           : RANGE_OFF64 + load / 2;
+}
+
+static int32_t rangeRaw(uint8_t sel, int32_t load)
+{
+    return rangeCount(sel, load) ^ 0x800000L;
+}
+
+static void testXh17Range(void)
+{
+    xh17Sample_t s128 = { .sel = xh17_inputSelect_A_128 };
+    xh17Sample_t s64 = { .sel = xh17_inputSelect_A_64 };
+    xh17Sample_t s;
+    int32_t a, b;
+    uint8_t refs = 0;
+
+    xh17_setAutoRange(&scaler, 1);
+    xh17_startAsync(&scaler);
+
+    s128.raw = rangeRaw(xh17_inputSelect_A_128, RANGE_LOAD);
+    s64.raw = rangeRaw(xh17_inputSelect_A_64, RANGE_LOAD);
+    xh17_sampleToRaw(&scaler, &s128, &a);
+    xh17_sampleToRaw(&scaler, &s64, &b);
+    printf("  range switch jump without reference: %ld counts\n", (long)(b - a));
+
+    // Tare at an empty platform, then the reference conversions
+    xh17_setOffset(&scaler, (uint32_t)rangeRaw(xh17_inputSelect_A_128, 0));
+    xh17_calibrateRange(&scaler);
+    for (uint8_t i = 0; i < 10; i++) {
+        hxConvert(rangeCount((hx.pulses == 27) ? xh17_inputSelect_A_64 : xh17_inputSelect_A_128, 0));
+        scaler_irqHandler();
+        while (xh17_popSample(&scaler, &s)) {
+            if (s.sel == xh17_inputSelect_A_64_ref) {
+                refs++;
+            }
+            xh17_sampleToRaw(&scaler, &s, &a);
+        }
+    }
+    check((refs == XH17_RANGE_REF_SAMPLES) && (hx.pulses == 25),
+          "xh17: range reference taken at gain 64");
+    check((scaler.ref64 == rangeRaw(xh17_inputSelect_A_64, 0)) &&
+          (scaler.ref128 == (int32_t)scaler.offset),
+          "xh17: range reference from the tare");
+
+    xh17_sampleToRaw(&scaler, &s128, &a);
+    xh17_sampleToRaw(&scaler, &s64, &b);
+    check(a == b, "xh17: no jump at a range switch");
+
+    xh17_stopAsync(&scaler);
+    xh17_setAutoRange(&scaler, 0);
+    xh17_setOffset(&scaler, 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void testXh17Group(void)
+{
+    static const int32_t values[GRP_CHANNELS] = { 0, -1, 0x7FFFFF, -123456 };
+    static const int32_t full[GRP_CHANNELS] = { 0x7FFFFF, -0x800000, 0x7FFFFF, 1 };
+    int64_t expect = 0;
+    uint8_t ok = 1;
+
+    grpConvert(values);
+    xh17_groupInitHw(&cells);
+    check(cells.channels == GRP_CHANNELS, "xh17 group: one channel per DOUT bit");
+
+    grpConvert(values);
+    xh17_groupReadRaw(&cells);
+    for (uint8_t ch = 0; ch < GRP_CHANNELS; ch++) {
+        if (cells.raw[ch] != ((values[ch] & 0xFFFFFFL) ^ 0x800000L)) {
+            ok = 0;
+        }
+    }
+    check(ok && (grp.pulses == 25), "xh17 group: all chips in one pass");
+
+    // Full scale with trims above the maximum: d * trim would need 40 bits
+    grpConvert(full);
+    xh17_groupReadRaw(&cells);
+    for (uint8_t ch = 0; ch < GRP_CHANNELS; ch++) {
+        cells.offset[ch] = (ch == 1) ? 0xFFFFFF : 0;
+        xh17_groupSetTrim(&cells, ch, (ch == 3) ? XH17_TRIM_ONE_Q12 : UINT16_MAX);
+        expect += ((int64_t)(cells.raw[ch] - cells.offset[ch]) * cells.trim_q12[ch]) >> 12;
+    }
+    check(cells.trim_q12[0] == XH17_TRIM_MAX_Q12, "xh17 group: trim clamped");
+    check(xh17_groupSum(&cells) == expect, "xh17 group: trimmed sum at full scale");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void testTm1637(void)
+{
+    static const uint8_t full[] = { 1, 0x40, 5, 0xC0, 0x06, 0x5B, 0x4F, 0x66 };
+    static const uint8_t one[] = { 1, 0x44, 2, 0xC3, 0x6F };
+    uint64_t t0;
+
+    tm1637_initHw(&disp);
+
+    tm.logLen = 0;
+    t0 = hal_native_timeNs();
+    tm1637_print(&disp, "1234");
+    printf("  bus time of a full frame: %lu ns\n", (unsigned long)(hal_native_timeNs() - t0));
+    check((tm.logLen == sizeof(full)) && !memcmp(tm.log, full, sizeof(full)),
+          "tm1637: full frame in auto-increment mode");
+    check(tm1637_getStatus(&disp) == tm1637_status_ok, "tm1637: all bytes acknowledged");
+
+    tm.logLen = 0;
+    tm1637_print(&disp, "1239");
+    check((tm.logLen == sizeof(one)) && !memcmp(tm.log, one, sizeof(one)),
+          "tm1637: one changed digit in fixed address mode");
+
+    tm.logLen = 0;
+    tm1637_print(&disp, "1239");
+    check(tm.logLen == 0, "tm1637: unchanged frame is not sent");
+}
+
+/* Timer2 bus engine, one edge per tick through the generated disp_tick() and
+through the pin table */
+static void testTm1637Async(void)
+{
+    static const uint8_t full[] = { 1, 0x40, 5, 0xC0, 0x6D, 0x7D, 0x07, 0x7F };
+    static const uint8_t back[] = { 1, 0x40, 5, 0xC0, 0x06, 0x5B, 0x4F, 0x66 };
+    uint16_t ticks = 0;
+
+    tm1637_asyncInit(&disp, NULL);
+
+    tm.logLen = 0;
+    tm1637_print(&disp, "5678");
+    while (tm1637_isBusy(&disp) && (ticks < 1000)) {
+        disp_tick();
+        ticks++;
+    }
+    check((tm.logLen == sizeof(full)) && !memcmp(tm.log, full, sizeof(full)) &&
+          (tm1637_getStatus(&disp) == tm1637_status_ok),
+          "tm1637: async frame, disp_tick()");
+    printf("  bus edges of a full frame: %u ticks of %u us\n", ticks, TM1637_TICK_US);
+
+    tm.logLen = 0;
+    tm1637_print(&disp, "1234");
+    for (ticks = 0; tm1637_isBusy(&disp) && (ticks < 1000); ticks++) {
+        tm1637_tick(&disp);
+    }
+    check((tm.logLen == sizeof(back)) && !memcmp(tm.log, back, sizeof(back)),
+          "tm1637: async frame, pin table");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void testButton(void)
+{
+    uint8_t press = 0;
+    uint8_t longPress = 0;
+    buttonEvent_t ev;
+
+    PINB |= (1 << 0);   // released, pulled up
+    button_initHw(&buttonTare);
+    check((PORTB & (1 << 0)) && !(DDRB & (1 << 0)), "button: input with pull-up");
+
+    PINB &= ~(1 << 0);
+    for (uint16_t i = 0; i < BUTTON_LONG_PRESS_TICKS + 10; i++) {
+        button_tick(&buttonTare);
+        while ((ev = button_getEvent(&buttonTare)) != button_event_none) {
+            if (ev == button_event_press) {
+                press = (uint8_t)(i + 1);
+            } else if (ev == button_event_longPress) {
+                longPress = 1;
+            }
+        }
+    }
+    check(press == BUTTON_INTEGRATOR_MAX, "button: press after the debounce time");
+    check(longPress, "button: long press");
+
+    PINB |= (1 << 0);
+    for (uint8_t i = 0; i < BUTTON_INTEGRATOR_MAX; i++) {
+        button_tick(&buttonTare);
+    }
+    check(!button_isPressed(&buttonTare), "button: release");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* COBS frame without its delimiter back to the frame bytes */
+static uint8_t cobsDecode(const uint8_t *src, uint8_t len, uint8_t *dst)
+{
+    uint8_t n = 0;
+    uint8_t i = 0;
+
+    while (i < len) {
+        uint8_t code = src[i++];
+
+        for (uint8_t k = 1; (k < code) && (i < len); k++) {
+            dst[n++] = src[i++];
+        }
+        if ((code != 0xFF) && (i < len)) {
+            dst[n++] = 0;
+        }
+    }
+
+    return n;
+}
+
+static int32_t getLe32(const uint8_t *p)
+{
+    return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                     ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+}
+
+static void testUsart(void)
+{
+    static const uint8_t payload[] = { 0x11, 0x00, 0x22 };
+
+    USART0_init();
+    uartLen = 0;
+
+    check(tlm_sendFrame(&telemetry, TLM_TYPE_SAMPLES, payload, sizeof(payload)),
+          "usart: telemetry frame queued");
+    uartDrain();
+
+    /* header + payload + CRC, COBS code byte, delimiter */
+    check((uartLen == TLM_HEADER_SIZE + sizeof(payload) + TLM_CRC_SIZE + 2) &&
+          (uartLog[uartLen - 1] == 0) && (memchr(uartLog, 0, uartLen - 1) == NULL),
+          "usart: COBS frame drained through the UDRE ISR");
+    check(USART0_TxFree() == USART0_TX_BUFFER_SIZE, "usart: queue empty");
+
+    // Auto-ranged gain 64 readings go past 24 bits, the sample keeps them.
+    // Sent as signed counts, the empty scale near 0x800000 is near 0.
+    tlmSample_t s = { .timestamp = 1234567, .raw = 0x17FFFFDL, .filtered = 0x7FFFF0L,
+                      .units = 50000, .flags = TLM_FLAG_STABLE };
+    uint8_t frame[TLM_FRAME_MAX];
+    uint8_t n;
+
+    uartLen = 0;
+    tlm_addSample(&telemetry, &s);
+    uartDrain();
+    n = cobsDecode(uartLog, uartLen - 1, frame);
+    check((n == TLM_HEADER_SIZE + 1 + TLM_SAMPLE_SIZE + TLM_CRC_SIZE) &&
+          (getLe32(&frame[TLM_HEADER_SIZE + 1 + 6]) == 0xFFFFFDL) &&
+          (getLe32(&frame[TLM_HEADER_SIZE + 1 + 10]) == -16) &&
+          (getLe32(&frame[TLM_HEADER_SIZE + 1 + 14]) == s.units),
+          "usart: sample sent as signed 32-bit counts");
+
+    // Blocking send into a full queue with interrupts off: polls, drops none
+    uint8_t sreg = SREG;
+    uint16_t dropped = USART0_GetDropCount();
+
+    cli();
+    while (USART0_TxFree()) {
+        USART0_Write("f", 1);
+    }
+    UCSR0A |= (1 << UDRE0);
+    USART0_SendChar('x');
+    check((USART0_GetDropCount() == dropped) && !USART0_TxFree(),
+          "usart: blocking send waits, drops nothing");
+    SREG = sreg;
+    uartDrain();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* Timer0 is stepped by hand: overflows through the ISR, TCNT0 and TOV0 set
+directly */
+static void testTime(void)
+{
+    timeTicks_t t;
+
+    time_init();
+    check((TCCR0B == ((1 << CS01) | (1 << CS00))) && (TIMSK0 == (1 << TOIE0)),
+          "time: Timer0 at F_CPU/64 with overflow interrupt");
+
+    for (uint16_t i = 0; i < 1000; i++) {
+        HAL_ISR_CALL(TIMER0_OVF_vect);
+    }
+    TCNT0 = 100;
+    t = time_ticks();
+    check(t == 1000UL * 256 + 100, "time: ticks from overflows and TCNT0");
+    check(time_ticksToUs(t) == 1024400, "time: ticks to microseconds");
+    check(time_ms() == 1024, "time: milliseconds with the 24 us fraction");
+    check(time_msToTicks(1024) == 1000UL * 256, "time: milliseconds to ticks");
+
+    // Overflow raised with interrupts off, ISR not run yet
+    TCNT0 = 2;
+    TIFR0 |= (1 << TOV0);
+    check(time_ticks() == 1001UL * 256 + 2, "time: pending overflow counted");
+    check(time_ticks32() == 1001UL * 256 + 2, "time: 32-bit read matches");
+    TIFR0 = 0;
+
+    // A 32-bit stamp from before the wrap of the low 32 bits, read after it
+    while (time_ticks() < 0xFFFFFF00ULL) {
+        HAL_ISR_CALL(TIMER0_OVF_vect);
+    }
+    t = time_ticks() - 1000;
+    for (uint16_t i = 0; i < 100; i++) {
+        HAL_ISR_CALL(TIMER0_OVF_vect);
+    }
+    check((time_ticks() >> 32) && (time_extend((uint32_t)t) == t),
+          "time: 32-bit stamp extended across its wrap");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* Advance Timer0 by ticks, through the overflow ISR on every wrap */
+static void timeAdvance(uint16_t ticks)
+{
+    while (ticks--) {
+        if (++TCNT0 == 0) {
+            HAL_ISR_CALL(TIMER0_OVF_vect);
+        }
+    }
+}
+
+/* Stand-ins for the tasks of src/main.c, each takes a typical runtime */
+static void simSample(void)    { timeAdvance(25); }     // 100 us
+static void simButtons(void)   { timeAdvance(5); }
+static void simDisplay(void)   { timeAdvance(250); }    // 1 ms, tm1637_print
+static void simTelemetry(void) { timeAdvance(50); }
+static void simCapture(void)   { timeAdvance(5); }
+static void simCommand(void)   { timeAdvance(5); }
+
+/* The task table of src/main.c over one simulated second. The background
+task gets the highest priority on purpose, it must not matter. */
+static void testSched(void)
+{
+    static schedTask_t tasks[] = {
+        SCHED_TASK(simSample,    0,                 3, 500),
+        SCHED_TASK(simButtons,   BUTTON_TICK_MS,    2, 1000),
+        SCHED_TASK(simDisplay,   TASK_DISPLAY_MS,   1, 1000),
+        SCHED_TASK(simTelemetry, TASK_TELEMETRY_MS, 1, 500),
+        SCHED_TASK(simCapture,   TASK_CAPTURE_MS,   1, 500),
+        SCHED_TASK(simCommand,   TASK_COMMAND_MS,   1, 200),
+    };
+    timeTicks_t end;
+    uint8_t ok = 1;
+
+    time_init();
+    sched_init(tasks, SCHED_TASK_COUNT(tasks));
+    end = time_ticks() + time_msToTicks(1000);
+
+    while (time_ticks() < end) {
+        if (!sched_run(tasks, SCHED_TASK_COUNT(tasks))) {
+            timeAdvance(1);
+        }
+    }
+
+    for (uint8_t i = 1; i < SCHED_TASK_COUNT(tasks); i++) {
+        if ((tasks[i].runs != 1000UL / tasks[i].periodMs) || tasks[i].lateRuns) {
+            ok = 0;
+        }
+    }
+    check(ok, "sched: periodic tasks run once per period");
+    // About 1 s less the periodic runtime, in 100 us runs
+    check((tasks[0].runs > 8000) && (tasks[0].runs < 10000),
+          "sched: background task runs between them");
+    printf("  runs in 1 s: sample %lu, buttons %lu, display %lu, capture %lu\n",
+           (unsigned long)tasks[0].runs, (unsigned long)tasks[1].runs,
+           (unsigned long)tasks[2].runs, (unsigned long)tasks[4].runs);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* Incremental save: one byte write per step at most, the record only counts
+once complete */
+static void testCalstore(void)
+{
+    calRecord_t rec;
+    calRecord_t got;
+    uint32_t writes;
+    uint16_t steps = 0;
+    uint16_t early = 0;
+    uint8_t ok = 1;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.offset = 0x812345;
+    rec.spanCounts = 421337;
+    rec.spanUnits = 1000;
+    calstore_save(&rec);
+
+    rec.spanCounts = 421000;
+    calstore_saveStart(&rec);
+    while (1) {
+        writes = hal_native_eepromWrites();
+        if (calstore_saveStep()) {
+            break;
+        }
+        steps++;
+        ok &= (hal_native_eepromWrites() - writes <= 1);
+        // Until the last byte the previous record is the newest valid one
+        // The new record is valid from its last byte on, before that the
+        // previous one is the newest valid record
+        ok &= calstore_load(&got) && (got.spanCounts == 421337 || got.spanCounts == 421000);
+        early += (got.spanCounts == 421000);
+    }
+    check(ok && steps && (early == 1), "calstore: a byte per step, old record kept meanwhile");
+    check(calstore_load(&got) && (got.spanCounts == 421000) && (got.seq == rec.seq),
+          "calstore: new record complete");
+
+    writes = hal_native_eepromWrites();
+    calstore_saveStart(&rec);
+    check(calstore_saveStep() && (hal_native_eepromWrites() == writes),
+          "calstore: unchanged record writes nothing");
+    printf("  record %u bytes, %u steps\n", (unsigned)sizeof(rec), steps);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* Feed a load with noise of the given peak-to-peak per rate for ms, switching
+10/80 SPS like updateRate() in src/main.c */
+static void stableFeed(int32_t load, int32_t noise10, int32_t noise80, uint32_t ms)
+{
+    uint32_t end = rate.nowMs + ms;
+
+    while ((int32_t)(rate.nowMs - end) < 0) {
+        int32_t noise = rate.fast ? noise80 : noise10;
+        bool stable;
+
+        rate.lcg = rate.lcg * 1664525UL + 1013904223UL;
+        stable = stable_update(&stability,
+                               load + (int32_t)((rate.lcg >> 8) % (uint32_t)(noise + 1)) - noise / 2,
+                               rate.nowMs);
+
+        if (rate.fast == stable) {
+            rate.fast = !stable;
+            rate.switches++;
+            if (rate.fast) {
+                stable_setBand(&stability, STABLE_BAND_COUNTS_80SPS, STABLE_LEAVE_COUNTS_80SPS);
+            } else {
+                stable_setBand(&stability, STABLE_BAND_COUNTS, STABLE_LEAVE_COUNTS);
+            }
+            stable_restart(&stability);
+        }
+        rate.nowMs += rate.fast ? 12 : 100;
+    }
+}
+
+/* The 80 SPS noise passes the 80 SPS band but not the 10 SPS one: the
+samples taken before a switch must not throw the state back */
+static void testStable(void)
+{
+    // Powered up a while ago: the first settle counts from the reset
+    rate.nowMs = 50000;
+    rate.fast = 1;
+    rate.switches = 0;
+    rate.lcg = 777;
+    stable_reset(&stability, rate.nowMs);
+
+    stableFeed(100000, 3000, 6000, 20000);
+    check(stable_isStable(&stability) && (rate.switches == 1),
+          "stable: settles, one switch to 10 SPS");
+    check(stable_timeToStable(&stability) < 2 * STABLE_HOLD_MS,
+          "stable: first time to stable from the reset");
+
+    // Above the band but inside the leave band
+    stableFeed(100000, 6000, 6000, 10000);
+    check(stable_isStable(&stability) && (rate.switches == 1),
+          "stable: hysteresis keeps the state");
+
+    stableFeed(130000, 3000, 6000, 5000);
+    check(stable_isStable(&stability) && (rate.switches == 3),
+          "stable: load step leaves and settles again");
+    check((stable_timeToStable(&stability) >= STABLE_HOLD_MS) &&
+          (stable_timeToStable(&stability) < 2 * STABLE_HOLD_MS),
+          "stable: time to stable after the step");
+    printf("  rate switches %u, time to stable %lu ms\n", rate.switches,
+           (unsigned long)stable_timeToStable(&stability));
+
+    // The sample kept over a restart shows a step right at the switch
+    stable_restart(&stability);
+    check(!stable_update(&stability, 160000, rate.nowMs),
+          "stable: step right after a restart");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* calib_toUnits() against the exact quotient, rounded half up. The stated
+tolerance: off by one at most, and only where the exact value lies within
+|counts| / 2^(shift + 1) of the half-unit tie between the two results. */
+static uint8_t calibMatches(const calibCtxt_t *cal, int32_t c, int32_t u,
+                            int32_t x, uint32_t *offByOne)
+{
+    __int128 num = (__int128)x * u * ((c < 0) ? -1 : 1);
+    __int128 den = (c < 0) ? -(__int128)c : c;
+    __int128 ref = 2 * num + den;
+    __int128 tie, lim;
+    int32_t y = calib_toUnits(cal, x);
+
+    // floor((2 num + den) / (2 den)), den > 0
+    ref = (ref >= 0) ? ref / (2 * den) : -((-ref + 2 * den - 1) / (2 * den));
+    if ((ref < INT32_MIN) || (ref > INT32_MAX)) {
+        return 1; // out of the output range, not a valid input
+    }
+    if (y == ref) {
+        return 1;
+    }
+    if ((y != ref + 1) && (y != ref - 1)) {
+        return 0;
+    }
+
+    // |x u / c - (ref + y) / 2| <= |x| / 2^(shift + 1)
+    tie = 2 * num - (ref + y) * den;
+    lim = (__int128)((x < 0) ? -(int64_t)x : x) * den;
+    (*offByOne)++;
+
+    return ((tie < 0) ? -tie : tie) * ((__int128)1 << cal->shift) <= lim;
+}
+
+static void testCalib(void)
+{
+    static const int32_t spans[][2] = {
+        { 421337, 1000 }, { -421337, 1000 }, { 421337, -1000000 },
+        { 1, 1 }, { 3, 1 }, { 7, 100000 }, { 8388607, 1 },
+        { 123456, 5000000 }, { 0x7FFFFFFF, 0x7FFFFFFF }, { 1000, 1000 },
+    };
+    calibCtxt_t cal = { CALIB_CTXT_DEFAULTS };
+    uint32_t lcg = 4242;
+    uint32_t offByOne = 0;
+    uint32_t total = 0;
+    uint8_t ok = 1;
+
+    for (uint8_t i = 0; i < sizeof(spans) / sizeof(spans[0]); i++) {
+        int32_t c = spans[i][0];
+        int32_t u = spans[i][1];
+
+        calib_setSpan(&cal, c, u);
+
+        for (int32_t x = -70000; x <= 70000; x++) {
+            ok &= calibMatches(&cal, c, u, x, &offByOne);
+        }
+        for (uint32_t n = 0; n < 1000000UL; n++) {
+            lcg = lcg * 1664525UL + 1013904223UL;
+            // Half the inputs 24 bit like the HX711, half the full range
+            ok &= calibMatches(&cal, c, u, (n & 1) ? (int32_t)lcg : (int32_t)lcg >> 8,
+                               &offByOne);
+        }
+        total += 140001UL + 1000000UL;
+    }
+    check(ok, "calib: exact or off by one next to a tie");
+    printf("  %lu of %lu conversions off by one\n", (unsigned long)offByOne,
+           (unsigned long)total);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* Replay the trace through the taskSample() path: sampleToRaw, stability,
+filter, zero tracking */
+static void driftRun(int32_t zero, int32_t creep, int32_t load, int32_t noise,
+                      uint32_t samples)
+{
+    for (uint32_t i = 0; i < samples; i++) {
+        int32_t before = xh17_getDrift(&drifter);
+        xh17Sample_t s = { .sel = xh17_inputSelect_A_128 };
+        int32_t raw;
+        bool stable;
+
+        drift.lcg = drift.lcg * 1664525UL + 1013904223UL;
+        s.raw = zero + (int32_t)((int64_t)creep * i / samples) + load +
+                (int32_t)((drift.lcg >> 8) % (uint32_t)(noise + 1)) - noise / 2;
+        if (!xh17_sampleToRaw(&drifter, &s, &raw)) {
+            continue;
+        }
+
+        stable = stable_update(&stability, raw, drift.nowMs);
+        xh17_zeroTrack(&drifter, xh17_filter(&drifter, raw), stable);
+
+        if (labs(xh17_getDrift(&drifter) - before) > drift.maxStep) {
+            drift.maxStep = labs(xh17_getDrift(&drifter) - before);
+        }
+        drift.nowMs += 100;
+    }
+}
+
+static void testDrift(void)
+{
+    const int32_t zero = 100000;
+    int32_t d;
+
+    drift.nowMs = 0;
+    drift.lcg = 31337;
+    drift.maxStep = 0;
+    xh17_setOffset(&drifter, zero);
+    xh17_setZeroTracking(&drifter, AZT_BAND_COUNTS, AZT_STEP_COUNTS);
+    stable_setBand(&stability, STABLE_BAND_COUNTS, STABLE_LEAVE_COUNTS);
+    stable_reset(&stability, 0);
+    driftRun(zero, 0, 0, 400, 100);
+
+    // Creep of 2500 counts over an hour at rest: followed to within the
+    // filter's output dead band, the counter is the offset moved
+    driftRun(zero, 2500, 0, 400, 36000);
+    check(labs((int32_t)drifter.offset - (zero + 2500)) <= XH17_OUT_DEAD_BAND_DEFAULT,
+          "drift: creep tracked");
+    check(xh17_getDrift(&drifter) == (int32_t)drifter.offset - zero,
+          "drift: counter matches the offset change");
+
+    // A 2500 count step at rest, inside the band: never faster than the step
+    d = xh17_getDrift(&drifter);
+    drift.maxStep = 0;
+    driftRun(zero + 2500, 0, 2500, 400, 1000);
+    check((drift.maxStep == AZT_STEP_COUNTS) && (xh17_getDrift(&drifter) > d),
+          "drift: rate limited to the step");
+    printf("  creep 2500 + step 2500: drift %ld counts, max %ld per sample\n",
+           (long)xh17_getDrift(&drifter), (long)drift.maxStep);
+
+    // A load outside the zero band, and motion near zero, are left alone
+    d = xh17_getDrift(&drifter);
+    driftRun(zero + 5000, 0, 10000, 400, 36000);
+    check(xh17_getDrift(&drifter) == d, "drift: load outside the band kept");
+    driftRun(zero + 5000, 0, 0, 12000, 3000);
+    check(xh17_getDrift(&drifter) == d, "drift: no tracking in motion");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* fmt_fixed() through snprintf: truncated toward zero, "-" only when a
+non-zero digit is left, at least one integer digit */
+static int fixedRef(char *buf, int32_t value, uint8_t fracDigits,
+                    uint8_t fracShown, uint8_t intWidth, char point)
+{
+    static const uint32_t pow10[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+        1000000000
+    };
+    uint32_t mag = (value < 0) ? -(uint32_t)value : (uint32_t)value;
+    uint32_t t = mag / pow10[fracDigits - fracShown];
+    int width = (intWidth > 10 - fracDigits) ? 10 - fracDigits : intWidth;
+    int n;
+
+    n = snprintf(buf, FMT_FIXED_BUF_SIZE, "%s%0*lu", ((value < 0) && t) ? "-" : "",
+                 width ? width : 1, (unsigned long)(t / pow10[fracShown]));
+    if (fracShown) {
+        if (point) {
+            buf[n++] = point;
+        }
+        n += snprintf(buf + n, FMT_FIXED_BUF_SIZE - n, "%0*lu", (int)fracShown,
+                      (unsigned long)(t % pow10[fracShown]));
+    }
+
+    return n;
+}
+
+static uint8_t fmtMatches(int32_t v)
+{
+    char a[FMT_I32_BUF_SIZE];
+    char b[FMT_I32_BUF_SIZE];
+    uint8_t ok;
+
+    ok = (fmt_i32(a, v) == snprintf(b, sizeof(b), "%ld", (long)v)) && !strcmp(a, b);
+    ok &= (fmt_u32(a, (uint32_t)v) == snprintf(b, sizeof(b), "%lu", (unsigned long)(uint32_t)v)) &&
+          !strcmp(a, b);
+
+    return ok;
+}
+
+static uint8_t fixedMatches(int32_t v)
+{
+    char a[FMT_FIXED_BUF_SIZE];
+    char b[FMT_FIXED_BUF_SIZE];
+    uint8_t ok = 1;
+
+    for (uint8_t d = 0; d <= 9; d++) {
+        for (uint8_t k = 0; k <= d; k++) {
+            for (uint8_t w = 0; w <= 10; w += 3) {
+                ok &= (fmt_fixed(a, v, d, k, w, '.') == fixedRef(b, v, d, k, w, '.')) &&
+                      !strcmp(a, b);
+                ok &= (fmt_fixed(a, v, d, k, w, '\0') == fixedRef(b, v, d, k, w, '\0')) &&
+                      !strcmp(a, b);
+            }
+        }
+    }
+
+    return ok;
+}
+
+/* Every int16, the int32 edges, a stride over the whole int32 range and
+random values, against snprintf */
+static void testFmt(void)
+{
+    static const int32_t edges[] = {
+        INT32_MIN, INT32_MIN + 1, -1000000000, -999999999, -100000, -99999,
+        99999, 100000, 999999999, 1000000000, INT32_MAX - 1, INT32_MAX
+    };
+    uint32_t lcg = 99;
+    uint8_t ok = 1;
+    uint8_t fixedOk = 1;
+
+    for (int32_t v = INT16_MIN; v <= INT16_MAX; v++) {
+        ok &= fmtMatches(v);
+        if (!(v % 7)) {
+            fixedOk &= fixedMatches(v);
+        }
+    }
+    for (uint8_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        ok &= fmtMatches(edges[i]);
+        fixedOk &= fixedMatches(edges[i]);
+    }
+    for (int64_t v = INT32_MIN; v <= INT32_MAX; v += 65537) {
+        ok &= fmtMatches((int32_t)v);
+    }
+    for (uint32_t n = 0; n < 1000000UL; n++) {
+        lcg = lcg * 1664525UL + 1013904223UL;
+        ok &= fmtMatches((int32_t)lcg);
+        if (!(n % 512)) {
+            fixedOk &= fixedMatches((int32_t)lcg);
+        }
+    }
+    check(ok, "fmt: i32/u32 match snprintf");
+    check(fixedOk, "fmt: fixed matches snprintf");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void bench(const char *name, double seconds)
+{
+    printf("  %-24s %7.2f ns/call\n", name, seconds * 1e9 / BENCH_LOOPS);
+}
+
+static void runBenchmarks(void)
+{
+    static filterPipe_t pipe;
+    static calibCtxt_t cal = { CALIB_CTXT_DEFAULTS };
+    volatile int32_t sink = 0;
+    char buf[FMT_FIXED_BUF_SIZE];
+    uint32_t lcg = 12345;
+    clock_t t0;
+
+    printf("host benchmarks, %lu calls each:\n", BENCH_LOOPS);
+    printf("  (PC timings, they do not represent the AVR: fmt_* avoids the\n"
+           "  AVR's software 32-bit division, the PC divides in hardware.\n"
+           "  AVR cycles: pc/simavr with \"pio run -e sim_fmt\")\n");
+
+    filter_init(&pipe);
+    filter_addAdaptiveEma(&pipe, 500, 5000, 16, 200);
+    filter_addDeadBand(&pipe, 20);
+    t0 = clock();
+    for (uint32_t i = 0; i < BENCH_LOOPS; i++) {
+        lcg = lcg * 1664525UL + 1013904223UL;
+        sink = filter_process(&pipe, 100000 + (int32_t)(lcg >> 20));
+    }
+    bench("filter ema+deadband", (double)(clock() - t0) / CLOCKS_PER_SEC);
+
+    calib_setSpan(&cal, 421337, 1000);
+    t0 = clock();
+    for (uint32_t i = 0; i < BENCH_LOOPS; i++) {
+        lcg = lcg * 1664525UL + 1013904223UL;
+        sink = calib_toUnits(&cal, (int32_t)(lcg >> 8) - 0x800000L);
+    }
+    bench("calib_toUnits", (double)(clock() - t0) / CLOCKS_PER_SEC);
+
+    t0 = clock();
+    for (uint32_t i = 0; i < BENCH_LOOPS; i++) {
+        lcg = lcg * 1664525UL + 1013904223UL;
+        sink = fmt_fixed(buf, (int32_t)(lcg >> 12), 3, 1, 1, '.');
+    }
+    bench("fmt_fixed", (double)(clock() - t0) / CLOCKS_PER_SEC);
+
+    t0 = clock();
+    for (uint32_t i = 0; i < BENCH_LOOPS; i++) {
+        lcg = lcg * 1664525UL + 1013904223UL;
+        sink = fixedRef(buf, (int32_t)(lcg >> 12), 3, 1, 1, '.');
+    }
+    bench("snprintf fixed", (double)(clock() - t0) / CLOCKS_PER_SEC);
+
+    t0 = clock();
+    for (uint32_t i = 0; i < BENCH_LOOPS; i++) {
+        lcg = lcg * 1664525UL + 1013904223UL;
+        sink = fmt_i32(buf, (int32_t)lcg);
+    }
+    bench("fmt_i32", (double)(clock() - t0) / CLOCKS_PER_SEC);
+
+    t0 = clock();
+    for (uint32_t i = 0; i < BENCH_LOOPS; i++) {
+        lcg = lcg * 1664525UL + 1013904223UL;
+        sink = snprintf(buf, sizeof(buf), "%ld", (long)(int32_t)lcg);
+    }
+    bench("snprintf %ld", (double)(clock() - t0) / CLOCKS_PER_SEC);
+
+    (void)sink;
+}
+
+/******************************************************************************/
+/*                                    Main                                    */
+/******************************************************************************/
+int main(void)
+{
+    hal_native_reset();
+    hal_native_setPortHook(portHook);
+
+    testXh17();
+    testXh17Async();
+    testXh17Range();
+    testXh17Group();
+    testTm1637();
+    testTm1637Async();
+    testButton();
+    testUsart();
+    testTime();
+    testSched();
+    testStable();
+    testCalstore();
+    testDrift();
+    testCalib();
+    testFmt();
+
+    runBenchmarks();
+
+    printf("%u check(s) failed\n", failures);
+
+    return failures;
+}
@@ -0,0 +1,421 @@
+/*
+ * Offline replay of raw sample traces (PlatformIO env "replay").
+ *
+ * Reads a file written by pc/traceRecorder.py and runs every conversion
+ * through the same path as taskSample() in src/main.c: xh17_sampleToRaw,
+ * stability detection, the xh17 filter pipeline, zero tracking and the
+ * calibration. The 10/80 SPS switch is taken from the recorded sample
+ * spacing, so the filter time constants follow the recording. The 32-bit
+ * micros() timestamps of the trace are unwrapped to 64 bits while loading,
+ * a recording longer than 71 minutes keeps counting up.
+ *
+ * stdout: CSV series "timestamp_us,tag,raw,filtered,units,stable" of the
+ *         channel A samples
+ * stderr: record counts, conversion spacing and gaps, host time per record,
+ *         filter cost per sample and the settling time of each load change
+ *
+ * Usage: program [-z offset] [-k spanCounts:spanUnits] [-a 0|1] trace.bin
+ */
+#include "hal_lib.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "xh17_lib.h"
+#include "stable_lib.h"
+#include "trace_lib.h"
+#include "scales_config.h"
+
+/******************************************************************************/
+/*                             Internal definitions                           */
+/******************************************************************************/
+
+/* Spacing below this means the recording ran at 80 SPS */
+#define RATE_80SPS_MAX_DT_US     50000UL
+#define PERIOD_10SPS_US          100000UL
+#define PERIOD_80SPS_US          12500UL
+
+/* Filter benchmark: passes over the recorded series */
+#define BENCH_PASSES             200
+
+/* Settled: the filtered reading stays within this of the raw mean taken
+once stable again */
+#define SETTLE_BAND_COUNTS       STABLE_BAND_COUNTS
+
+typedef struct {
+    uint64_t timestamp;     // micros() of the recording, unwrapped
+    int32_t raw;
+    int32_t filtered;
+    int32_t units;
+    uint8_t tag;
+    uint8_t stable;
+    uint8_t kept;           // went through the sample path (channel A)
+} replaySample_t;
+
+XH17_DECLARE_CTXT_RATE(scaler, PORTD, 5, PORTD, 6, PORTD, 7);
+STABLE_DECLARE_CTXT(stability, STABLE_BAND_COUNTS, STABLE_LEAVE_COUNTS, STABLE_HOLD_MS);
+
+static replaySample_t *samples;
+static size_t sampleCount;
+static size_t sampleCap;
+
+/******************************************************************************/
+/*                        Static function definitions                         */
+/******************************************************************************/
+static void addSample(const traceRecord_t *rec, uint64_t timestamp)
+{
+    if (sampleCount == sampleCap) {
+        sampleCap = sampleCap ? sampleCap * 2 : 1024;
+        samples = realloc(samples, sampleCap * sizeof(*samples));
+        if (!samples) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+    }
+
+    memset(&samples[sampleCount], 0, sizeof(*samples));
+    samples[sampleCount].timestamp = timestamp;
+    samples[sampleCount].raw = rec->raw;
+    samples[sampleCount].tag = rec->tag;
+    sampleCount++;
+}
+
+/* Returns the number of blocks read, -1 if the file is not a trace */
+static long loadTrace(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    char magic[TRACE_FILE_MAGIC_LEN];
+    uint8_t block[UINT8_MAX];
+    uint64_t timestamp = 0;
+    uint32_t lastTs = 0;
+    long blocks = 0;
+    int len;
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+
+    if ((fread(magic, 1, sizeof(magic), f) != sizeof(magic)) ||
+        memcmp(magic, TRACE_FILE_MAGIC, sizeof(magic))) {
+        fprintf(stderr, "%s: not a trace file\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    while ((len = fgetc(f)) != EOF) {
+        traceReader_t rd;
+        traceRecord_t rec;
+
+        if (fread(block, 1, (size_t)len, f) != (size_t)len) {
+            fprintf(stderr, "%s: truncated block %ld\n", path, blocks);
+            break;
+        }
+
+        trace_open(&rd, block, (uint8_t)len);
+        while (trace_next(&rd, &rec)) {
+            // Only forward steps: the unsigned difference crosses a wrap
+            timestamp = sampleCount ? timestamp + (uint32_t)(rec.timestamp - lastTs)
+                                    : rec.timestamp;
+            lastTs = rec.timestamp;
+            addSample(&rec, timestamp);
+        }
+        blocks++;
+    }
+
+    fclose(f);
+
+    return blocks;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* The taskSample() path for one recorded conversion */
+static void process(replaySample_t *s, uint64_t *lastA)
+{
+    xh17Sample_t x = { .raw = s->raw, .sel = s->tag };
+    int32_t raw;
+
+    if (!xh17_sampleToRaw(&scaler, &x, &raw)) {
+        return;
+    }
+
+    if (*lastA && (s->timestamp != *lastA)) {
+        bool fast = (s->timestamp - *lastA) < RATE_80SPS_MAX_DT_US;
+        xh17_rate_t rate = fast ? xh17_rate_80SPS : xh17_rate_10SPS;
+
+        if ((rate != scaler.rate) && xh17_setRate(&scaler, rate)) {
+            if (fast) {
+                stable_setBand(&stability, STABLE_BAND_COUNTS_80SPS, STABLE_LEAVE_COUNTS_80SPS);
+            } else {
+                stable_setBand(&stability, STABLE_BAND_COUNTS, STABLE_LEAVE_COUNTS);
+            }
+            // The window holds the other rate's noise, the state stays
+            stable_restart(&stability);
+        }
+    }
+    *lastA = s->timestamp;
+
+    // millis() of the firmware: 32 bits, wraps the same way
+    s->stable = stable_update(&stability, raw, (uint32_t)(s->timestamp / 1000));
+    s->raw = raw;
+    s->filtered = xh17_filter(&scaler, raw);
+    xh17_zeroTrack(&scaler, s->filtered, s->stable);
+    s->units = xh17_toUnits(&scaler, s->filtered);
+    s->kept = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* xh17_filter() alone over the replayed series, from the filter state the
+replay started with. Rate switches are not repeated, the time constants
+stay those of the start. */
+static void benchFilter(const filterPipe_t *start)
+{
+    volatile int32_t sink = 0;
+    uint64_t kept = 0;
+    struct timespec t0, t1;
+    double ns;
+#if defined(__x86_64__) || defined(__i386__)
+    uint64_t tsc;
+#endif
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+#if defined(__x86_64__) || defined(__i386__)
+    tsc = __rdtsc();
+#endif
+    for (uint16_t pass = 0; pass < BENCH_PASSES; pass++) {
+        scaler.filt = *start;
+        for (size_t i = 0; i < sampleCount; i++) {
+            if (samples[i].kept) {
+                sink = xh17_filter(&scaler, samples[i].raw);
+                kept++;
+            }
+        }
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    tsc = __rdtsc() - tsc;
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    (void)sink;
+
+    if (!kept) {
+        return;
+    }
+
+    ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+#if defined(__x86_64__) || defined(__i386__)
+    fprintf(stderr, "filter: %.1f ns, %.1f TSC cycles per sample\n", ns / kept,
+            (double)tsc / kept);
+#else
+    fprintf(stderr, "filter: %.1f ns per sample\n", ns / kept);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* Settling time of every load change: from the first motion sample (stable
+lost) to the sample from which the filtered reading stays within
+SETTLE_BAND_COUNTS of the settled value until the next load change. The
+settled value is the raw mean over the first STABLE_WINDOW samples once the
+detector is stable again. */
+static void printSettling(void)
+{
+    uint32_t steps = 0;
+    uint32_t unsettled = 0;
+    uint64_t sumUs = 0;
+    uint64_t maxUs = 0;
+    size_t last = SIZE_MAX;     // previous kept sample
+
+    for (size_t i = 0; i < sampleCount; i++) {
+        size_t end, next, settled, n;
+        int64_t sum = 0;
+        int32_t target;
+
+        if (!samples[i].kept) {
+            continue;
+        }
+        if ((last == SIZE_MAX) || !samples[last].stable || samples[i].stable) {
+            last = i;
+            continue;
+        }
+        last = i;
+
+        // Stable again, the mean of the next window, the next load change
+        for (end = i; (end < sampleCount) && !(samples[end].kept && samples[end].stable); end++) {
+        }
+        for (n = 0, next = end; (next < sampleCount) && (n < STABLE_WINDOW); next++) {
+            if (samples[next].kept) {
+                sum += samples[next].raw;
+                n++;
+            }
+        }
+        if (n < STABLE_WINDOW) {
+            break;  // trace ends before it settles
+        }
+        target = (int32_t)(sum / STABLE_WINDOW);
+        for (next = end; (next < sampleCount) && !(samples[next].kept && !samples[next].stable); next++) {
+        }
+
+        // Walk back from there while the filtered reading is in the band
+        settled = next;
+        for (size_t j = next; j-- > i;) {
+            if (!samples[j].kept) {
+                continue;
+            }
+            if (labs(samples[j].filtered - target) > SETTLE_BAND_COUNTS) {
+                break;
+            }
+            settled = j;
+        }
+        if (settled == next) {
+            unsettled++;
+            continue;
+        }
+
+        uint64_t us = samples[settled].timestamp - samples[i].timestamp;
+
+        fprintf(stderr, "load change at %llu us: settled in %llu ms, stable after %llu ms\n",
+                (unsigned long long)samples[i].timestamp, (unsigned long long)(us / 1000),
+                (unsigned long long)((samples[end].timestamp - samples[i].timestamp) / 1000));
+        sumUs += us;
+        maxUs = (us > maxUs) ? us : maxUs;
+        steps++;
+    }
+
+    if (steps || unsettled) {
+        fprintf(stderr, "settling: %u load change(s), mean %llu ms, max %llu ms, %u not settled\n",
+                steps, (unsigned long long)(steps ? sumUs / steps / 1000 : 0),
+                (unsigned long long)(maxUs / 1000), unsettled);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void printStats(long blocks, double seconds)
+{
+    uint32_t tags[TRACE_TAGS] = { 0 };
+    uint32_t dtMin = UINT32_MAX;
+    uint32_t dtMax = 0;
+    uint64_t dtSum = 0;
+    uint32_t dtCount = 0;
+    uint32_t gaps = 0;
+
+    // Every conversion takes one HX711 period, whatever input it was on
+    for (size_t i = 0; i < sampleCount; i++) {
+        const replaySample_t *s = &samples[i];
+
+        tags[s->tag]++;
+
+        if (i) {
+            uint32_t dt = (uint32_t)(s->timestamp - samples[i - 1].timestamp);
+            uint32_t period = (dt < RATE_80SPS_MAX_DT_US) ? PERIOD_80SPS_US : PERIOD_10SPS_US;
+
+            dtMin = (dt < dtMin) ? dt : dtMin;
+            dtMax = (dt > dtMax) ? dt : dtMax;
+            dtSum += dt;
+            dtCount++;
+            if (dt > period + period / 2) {
+                gaps++;
+            }
+        }
+    }
+
+    fprintf(stderr, "%zu records in %ld blocks: A128 %u, B32 %u, A64 %u, A64 ref %u\n",
+            sampleCount, blocks, tags[xh17_inputSelect_A_128],
+            tags[xh17_inputSelect_B_32], tags[xh17_inputSelect_A_64],
+            tags[xh17_inputSelect_A_64_ref]);
+    if (dtCount) {
+        fprintf(stderr, "conversion spacing: min %u us, mean %.0f us, max %u us, %u gap(s)\n",
+                dtMin, (double)dtSum / dtCount, dtMax, gaps);
+    }
+    fprintf(stderr, "zero tracking: offset moved %d counts\n", xh17_getDrift(&scaler));
+    if (sampleCount) {
+        fprintf(stderr, "host processing: %.1f ns per record\n", seconds * 1e9 / sampleCount);
+    }
+}
+
+/******************************************************************************/
+/*                                    Main                                    */
+/******************************************************************************/
+int main(int argc, char *argv[])
+{
+    long offset = 0;
+    long spanCounts = 1;
+    long spanUnits = 1;
+    int autoRange = 1;
+    uint64_t lastA = 0;
+    filterPipe_t start;
+    long blocks;
+    clock_t t0;
+    double seconds;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "z:k:a:")) != -1) {
+        switch (opt) {
+            case 'z': offset = strtol(optarg, NULL, 0); break;
+            case 'a': autoRange = atoi(optarg); break;
+            case 'k':
+                if (sscanf(optarg, "%ld:%ld", &spanCounts, &spanUnits) != 2) {
+                    fprintf(stderr, "-k expects spanCounts:spanUnits\n");
+                    return 2;
+                }
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-z offset] [-k spanCounts:spanUnits] [-a 0|1] trace.bin\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-z offset] [-k spanCounts:spanUnits] [-a 0|1] trace.bin\n", argv[0]);
+        return 2;
+    }
+
+    blocks = loadTrace(argv[optind]);
+    if (blocks < 0) {
+        return 1;
+    }
+
+    hal_native_reset();
+    xh17_setOffset(&scaler, (uint32_t)offset);
+    xh17_setSpan(&scaler, (int32_t)spanCounts, (int32_t)spanUnits);
+    xh17_setAutoRange(&scaler, (uint8_t)autoRange);
+    xh17_setZeroTracking(&scaler, AZT_BAND_COUNTS, AZT_STEP_COUNTS);
+
+    if (sampleCount) {
+        stable_reset(&stability, (uint32_t)(samples[0].timestamp / 1000));
+    }
+
+    start = scaler.filt;
+    t0 = clock();
+    for (size_t i = 0; i < sampleCount; i++) {
+        process(&samples[i], &lastA);
+    }
+    seconds = (double)(clock() - t0) / CLOCKS_PER_SEC;
+
+    printf("timestamp_us,tag,raw,filtered,units,stable\n");
+    for (size_t i = 0; i < sampleCount; i++) {
+        const replaySample_t *s = &samples[i];
+
+        if ((s->tag == xh17_inputSelect_B_32) || (s->tag == xh17_inputSelect_A_64_ref)) {
+            continue;
+        }
+        printf("%llu,%u,%d,%d,%d,%u\n", (unsigned long long)s->timestamp, s->tag,
+               s->raw, s->filtered, s->units, s->stable);
+    }
+
+    printStats(blocks, seconds);
+    printSettling();
+    benchFilter(&start);
+    free(samples);
+
+    return 0;
+}